@@ -0,0 +1,254 @@
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#include"tar.h"
+#include"../profile/span.h"
+
+//ustar header fields, offsets into the 512 byte block.
+#define TAR_NAME 0
+#define TAR_NAME_LEN 100
+#define TAR_SIZE 124
+#define TAR_SIZE_LEN 12
+#define TAR_CHECKSUM 148
+#define TAR_CHECKSUM_LEN 8
+#define TAR_TYPE 156
+#define TAR_MAGIC 257
+#define TAR_PREFIX 345
+#define TAR_PREFIX_LEN 155
+
+static uint64_t tar_octal(const uint8_t *field, uint32_t len)
+{
+    //GNU base 256 for sizes past 8 GiB.
+    if(field[0] & 0x80)
+    {
+        uint64_t value = field[0] & 0x7F;
+        for(uint32_t i = 1; i < len; ++i)
+            value = (value << 8) | field[i];
+        return value;
+    }
+    uint64_t value = 0;
+    for(uint32_t i = 0; i < len && field[i]; ++i)
+    {
+        if(field[i] >= '0' && field[i] <= '7')
+            value = (value << 3) | (uint64_t)(field[i] - '0');
+    }
+    return value;
+}
+
+static bool tar_checksum(const uint8_t *header)
+{
+    uint32_t sum = 0;
+    for(uint32_t i = 0; i < TAR_BLOCK; ++i)
+        sum += (i >= TAR_CHECKSUM && i < TAR_CHECKSUM + TAR_CHECKSUM_LEN) ? ' ' : header[i];
+    return sum == tar_octal(header + TAR_CHECKSUM, TAR_CHECKSUM_LEN);
+}
+
+static bool tar_zero_block(const uint8_t *block)
+{
+    for(uint32_t i = 0; i < TAR_BLOCK; ++i)
+    {
+        if(block[i])
+            return false;
+    }
+    return true;
+}
+
+static uint32_t field_len(const uint8_t *field, uint32_t len)
+{
+    uint32_t n = 0;
+    while(n < len && field[n])
+        ++n;
+    return n;
+}
+
+//the path record of a pax extended header, "<len> path=<name>\n".
+static bool pax_path(const uint8_t *data, uint64_t size, const uint8_t **name, uint32_t *len)
+{
+    uint64_t pos = 0;
+    while(pos < size)
+    {
+        uint64_t record = 0;
+        uint64_t i = pos;
+        while(i < size && data[i] >= '0' && data[i] <= '9' && record <= size)
+            record = record * 10 + (data[i++] - '0');
+        if(record > size - pos || i >= size || data[i] != ' ')
+            return false;
+        ++i;
+        //the length counts itself, the space and the newline.
+        if(record < (i - pos) + 1 || data[pos + record - 1] != '\n')
+            return false;
+        uint64_t end = pos + record - 1;
+        if(i + 5 < end && memcmp(data + i, "path=", 5) == 0)
+        {
+            *name = data + i + 5;
+            *len = (uint32_t)(end - i - 5);
+            return true;
+        }
+        pos += record;
+    }
+    return false;
+}
+
+static tar_kind_t tar_classify(const char *name, uint32_t len, const uint8_t *data, uint64_t size)
+{
+    uint32_t magic;
+    if(size >= sizeof(image_header_t))
+    {
+        memcpy(&magic, data, sizeof(magic));
+        if(magic == IMAGE_MAGIC)
+            return TAR_IMAGE;
+    }
+    if(len >= 4 && strcmp(name + len - 4, ".obj") == 0)
+        return TAR_OBJ;
+    if(len >= 4 && strcmp(name + len - 4, ".asm") == 0)
+        return TAR_ASM;
+    return TAR_OTHER;
+}
+
+bool tar_view(tar_archive_t *archive, const uint8_t *data, uint64_t size)
+{
+    archive->base = data;
+    archive->size = size;
+    archive->mapped = false;
+    archive->members.clear();
+    archive->names.clear();
+    archive->truncated = false;
+
+    //a name from a GNU L or pax header applies to the next member.
+    const uint8_t *long_name = 0;
+    uint32_t long_len = 0;
+
+    uint64_t pos = 0;
+    while(pos + TAR_BLOCK <= size)
+    {
+        const uint8_t *header = data + pos;
+        if(tar_zero_block(header))
+            break;
+        if(!tar_checksum(header))
+        {
+            archive->truncated = true;
+            break;
+        }
+
+        uint64_t member_size = tar_octal(header + TAR_SIZE, TAR_SIZE_LEN);
+        const uint8_t *member_data = header + TAR_BLOCK;
+        uint64_t next = pos + TAR_BLOCK + (member_size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+        if(next > size || next < pos)
+        {
+            archive->truncated = true;
+            break;
+        }
+
+        uint8_t type = header[TAR_TYPE];
+        if(type == 'L')
+        {
+            long_name = member_data;
+            long_len = field_len(member_data, (uint32_t)member_size);
+        }
+        else if(type == 'x')
+        {
+            if(!pax_path(member_data, member_size, &long_name, &long_len))
+                long_name = 0;
+        }
+        else if(type == '0' || type == 0 || type == '7')
+        {
+            tar_member_t member;
+            member.name_offset = (uint32_t)archive->names.size();
+            if(long_name)
+            {
+                archive->names.insert(archive->names.end(), long_name, long_name + long_len);
+            }
+            else
+            {
+                //ustar splits long paths into prefix and name.
+                if(memcmp(header + TAR_MAGIC, "ustar", 5) == 0 && header[TAR_PREFIX])
+                {
+                    const uint8_t *prefix = header + TAR_PREFIX;
+                    archive->names.insert(archive->names.end(), prefix, prefix + field_len(prefix, TAR_PREFIX_LEN));
+                    archive->names.push_back('/');
+                }
+                const uint8_t *name = header + TAR_NAME;
+                archive->names.insert(archive->names.end(), name, name + field_len(name, TAR_NAME_LEN));
+            }
+            member.name_len = (uint32_t)archive->names.size() - member.name_offset;
+            archive->names.push_back(0);
+            member.data = member_data;
+            member.size = member_size;
+            member.kind = TAR_OTHER;
+            archive->members.push_back(member);
+            long_name = 0;
+        }
+        else
+        {
+            //directories, links, devices and global pax headers carry no program.
+            long_name = 0;
+        }
+        pos = next;
+    }
+
+    //names may have moved while the pool grew, classify once it is final.
+    for(tar_member_t &member : archive->members)
+        member.kind = tar_classify(archive->names.data() + member.name_offset, member.name_len,
+                                   member.data, member.size);
+    return true;
+}
+
+bool tar_open(tar_archive_t *archive, const char *path)
+{
+    SPAN_BEGIN(begin);
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+
+    //headers and members are visited once, front to back.
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    tar_view(archive, (const uint8_t *)data, (uint64_t)st.st_size);
+    archive->mapped = true;
+    SPAN_END(begin, SPAN_IMAGE_LOAD, (uint32_t)archive->members.size());
+    return true;
+}
+
+void tar_close(tar_archive_t *archive)
+{
+    if(archive->mapped)
+        munmap((void *)archive->base, (size_t)archive->size);
+    archive->base = 0;
+    archive->size = 0;
+    archive->mapped = false;
+    archive->members.clear();
+    archive->names.clear();
+}
+
+bool tar_load(const tar_member_t *member, machine_t *m)
+{
+    if(member->kind == TAR_OBJ)
+    {
+        machine_load_obj(m, member->data, (uint32_t)member->size);
+        return true;
+    }
+    if(member->kind == TAR_IMAGE)
+    {
+        //members start on a 512 byte boundary, the image tables stay aligned.
+        image_t image;
+        if(!image_view(&image, member->data, member->size) || image.header->isa != m->isa)
+            return false;
+        image_load(&image, m);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,69 @@
+#ifndef TAR_H
+#define TAR_H
+
+#include<vector>
+
+#include"../type/type.h"
+#include"../engine/machine.h"
+#include"../image/image.h"
+
+#define TAR_BLOCK 512
+
+//what a member holds, by content for images and by name otherwise.
+enum tar_kind_t
+{
+    TAR_OTHER,
+    TAR_OBJ,
+    TAR_IMAGE,
+    TAR_ASM
+};
+
+//a regular file of the archive, data points into the mapping.
+struct tar_member_t
+{
+    uint32_t name_offset;
+    uint32_t name_len;
+    const uint8_t *data;
+    uint64_t size;
+    tar_kind_t kind;
+};
+
+struct tar_archive_t
+{
+    const uint8_t *base;
+    uint64_t size;
+    bool mapped;
+
+    std::vector<tar_member_t> members;
+    //member names, NUL terminated.
+    std::vector<char> names;
+    //the index stopped at a damaged header, members before it are usable.
+    bool truncated;
+};
+
+/*
+function define:
+    map a ustar or GNU tar archive read only and index every regular file
+    in one pass over the headers, long names from GNU L and pax path records
+    nothing is copied, members are used in place
+*/
+bool tar_open(tar_archive_t *archive, const char *path);
+
+//index an archive already in memory.
+bool tar_view(tar_archive_t *archive, const uint8_t *data, uint64_t size);
+
+void tar_close(tar_archive_t *archive);
+
+inline const char *tar_member_name(const tar_archive_t *archive, const tar_member_t *member)
+{
+    return archive->names.data() + member->name_offset;
+}
+
+/*
+function define:
+    load a TAR_OBJ or TAR_IMAGE member into m, return false for any other kind
+    there is no assembler in this tree, TAR_ASM members are not loadable
+*/
+bool tar_load(const tar_member_t *member, machine_t *m);
+
+#endif //TAR_H
@@ -0,0 +1,100 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"tar.h"
+#include"../test/check.h"
+
+//AND R0,R0,#0; ADD R0,R0,#9; HALT at x3000.
+static const uint8_t program[] = {0x30, 0x00, 0x50, 0x20, 0x10, 0x29, 0xF0, 0x25};
+
+//append a ustar header and its data, padded to whole blocks.
+static void tar_add(std::vector<uint8_t> *tar, const char *name, char type, const void *data, uint32_t size)
+{
+    uint8_t header[TAR_BLOCK];
+    memset(header, 0, sizeof(header));
+    strncpy((char *)header, name, 100);
+    snprintf((char *)header + 100, 8, "%07o", 0644);
+    snprintf((char *)header + 124, 12, "%011o", size);
+    header[156] = (uint8_t)type;
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    memset(header + 148, ' ', 8);
+    uint32_t sum = 0;
+    for(uint32_t i = 0; i < TAR_BLOCK; ++i)
+        sum += header[i];
+    snprintf((char *)header + 148, 8, "%06o", sum);
+
+    tar->insert(tar->end(), header, header + TAR_BLOCK);
+    tar->insert(tar->end(), (const uint8_t *)data, (const uint8_t *)data + size);
+    tar->resize((tar->size() + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK, 0);
+}
+
+//the name of the one member that follows a pax header holding records.
+static bool pax_name(const char *records, uint32_t len, const char *expect)
+{
+    std::vector<uint8_t> tar;
+    tar_add(&tar, "PaxHeaders/plain.obj", 'x', records, len);
+    tar_add(&tar, "plain.obj", '0', program, sizeof(program));
+    tar.resize(tar.size() + 2 * TAR_BLOCK, 0);
+
+    tar_archive_t archive;
+    bool ok = tar_view(&archive, tar.data(), tar.size()) && !archive.truncated &&
+              archive.members.size() == 1 && !strcmp(tar_member_name(&archive, &archive.members[0]), expect);
+    tar_close(&archive);
+    return ok;
+}
+
+int main()
+{
+    char long_name[160];
+    memset(long_name, 'd', sizeof(long_name));
+    strcpy(long_name + 150, "/loop.asm");
+
+    std::vector<uint8_t> tar;
+    tar_add(&tar, "lab1/nine.obj", '0', program, sizeof(program));
+    tar_add(&tar, "lab1", '5', 0, 0);
+    tar_add(&tar, "././@LongLink", 'L', long_name, (uint32_t)strlen(long_name) + 1);
+    tar_add(&tar, "short-name", '0', ";", 1);
+    tar_add(&tar, "README", '0', "lab 1\n", 6);
+    tar.resize(tar.size() + 2 * TAR_BLOCK, 0);
+
+    tar_archive_t archive;
+    CHECK(tar_view(&archive, tar.data(), tar.size()));
+    CHECK(!archive.truncated);
+    CHECK(archive.members.size() == 3);
+    CHECK(!strcmp(tar_member_name(&archive, &archive.members[0]), "lab1/nine.obj"));
+    CHECK(archive.members[0].kind == TAR_OBJ && archive.members[0].size == sizeof(program));
+    //members point into the archive, nothing is copied.
+    CHECK(archive.members[0].data == tar.data() + TAR_BLOCK);
+    CHECK(!strcmp(tar_member_name(&archive, &archive.members[1]), long_name));
+    CHECK(archive.members[1].kind == TAR_ASM);
+    CHECK(archive.members[2].kind == TAR_OTHER);
+
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    machine_t *m = new machine_t();
+    machine_init(m, ISA_LC3, mem.data());
+    CHECK(!tar_load(&archive.members[1], m));
+    CHECK(tar_load(&archive.members[0], m));
+    machine_run(m, 100);
+    CHECK(m->state == MACHINE_HALTED && m->reg[0] == 9);
+    delete m;
+
+    //a damaged directory header stops the index, the members before it stay usable.
+    tar[TAR_BLOCK * 2 + 10] ^= 0x01;
+    CHECK(tar_view(&archive, tar.data(), tar.size()));
+    CHECK(archive.truncated && archive.members.size() == 1);
+    tar_close(&archive);
+
+    //a pax path record names the next member, other records are skipped.
+    const char pax[] = "20 mtime=1700000000\n21 path=pax/long.obj\n";
+    CHECK(pax_name(pax, sizeof(pax) - 1, "pax/long.obj"));
+    //malformed records are ignored and the ustar name stands: a length shorter than its
+    //own prefix, zero, past the data, without the newline, digits with no space and an empty path.
+    const char *bad[] = {"2 path=evil.obj\n", "0 path=evil.obj\n", "99 path=evil.obj\n",
+                         "17 path=evil.objx", "16path=evil.obj\n", "8 path=\n"};
+    for(const char *records : bad)
+        CHECK(pax_name(records, (uint32_t)strlen(records), "plain.obj"));
+
+    return check_result();
+}
@@ -0,0 +1,333 @@
+#include<string.h>
+#include<map>
+
+#include"batch.h"
+#include"../probe/probe.h"
+#include"../profile/span.h"
+
+//a group of jobs sharing a machine state, forked from a snapshot.
+struct batch_node_t
+{
+    machine_t machine;
+    snapshot_id_t snapshot;
+    std::vector<uint32_t> jobs;
+};
+
+//on_input context while a group of more than one job runs.
+struct batch_group_t
+{
+    const batch_t *batch;
+    const std::vector<uint32_t> *jobs;
+    uint32_t min_len;
+    uint32_t max_len;
+    //every job agrees on the input bytes below checked_pos.
+    uint32_t checked_pos;
+    word_t pc_step;
+
+    //machine state before the refused instruction.
+    input_kind_t kind;
+    word_t pc;
+    word_t psr;
+    word_t saved_ssp;
+    word_t saved_usp;
+    reg_t reg[0x8];
+};
+
+static bool group_agrees(batch_group_t *g, input_kind_t kind, uint32_t pos)
+{
+    if(g->min_len > pos)
+    {
+        if(kind != INPUT_BYTE || pos < g->checked_pos)
+            return true;
+        const std::vector<batch_job_t> &jobs = g->batch->jobs;
+        uint8_t c = jobs[(*g->jobs)[0]].input[pos];
+        for(uint32_t j : *g->jobs)
+        {
+            if(jobs[j].input[pos] != c)
+                return false;
+        }
+        g->checked_pos = pos + 1;
+        return true;
+    }
+    //no job has input left.
+    return g->max_len <= pos;
+}
+
+static bool group_on_input(machine_t *m, input_kind_t kind, void *ctx)
+{
+    batch_group_t *g = (batch_group_t *)ctx;
+    if(group_agrees(g, kind, m->input_pos))
+        return true;
+
+    //the observing instruction has only fetched so far, keep what it may still change.
+    g->kind = kind;
+    g->pc = kind == INPUT_INTERRUPT ? m->pc : m->pc - g->pc_step;
+    g->psr = m->psr;
+    g->saved_ssp = m->saved_ssp;
+    g->saved_usp = m->saved_usp;
+    memcpy(g->reg, m->reg, sizeof(g->reg));
+    return false;
+}
+
+static void group_rollback(const batch_group_t *g, machine_t *m)
+{
+    m->pc = g->pc;
+    m->psr = g->psr;
+    m->saved_ssp = g->saved_ssp;
+    m->saved_usp = g->saved_usp;
+    memcpy(m->reg, g->reg, sizeof(m->reg));
+    m->state = MACHINE_RUNNING;
+}
+
+//answer the refused read would give a job, a byte or 0x100 for none.
+static uint32_t job_answer(const batch_job_t *job, input_kind_t kind, uint32_t pos)
+{
+    if(kind != INPUT_BYTE)
+        return pos < job->input_len;
+    return pos < job->input_len ? job->input[pos] : 0x100;
+}
+
+static void job_finish(const batch_t *batch, batch_job_t *job, const machine_t *m)
+{
+    PROBE3(job_end, (uint32_t)(job - batch->jobs.data()), (uint32_t)m->state, m->instructions);
+    SPAN_BEGIN(begin);
+    job->state = m->state;
+    job->instructions = m->instructions;
+    job->cycles = m->cycles;
+    memcpy(job->reg, m->reg, sizeof(job->reg));
+    job->output = m->output;
+    SPAN_END(begin, SPAN_OUTPUT, (uint32_t)job->output.size());
+}
+
+static uint64_t budget(const batch_t *batch, const machine_t *m)
+{
+    return batch->max_instructions > m->instructions ? batch->max_instructions - m->instructions : 0;
+}
+
+void batch_init(batch_t *batch, const machine_t *init, uint64_t max_instructions)
+{
+    batch->init = init;
+    batch->jobs.clear();
+    batch->max_instructions = max_instructions;
+    batch->share_prefix = true;
+    batch->decode_store = 0;
+    batch->image_hash = 0;
+    batch->executed_instructions = 0;
+    batch->forks = 0;
+}
+
+void batch_add_job(batch_t *batch, const uint8_t *input, uint32_t input_len)
+{
+    batch_job_t job;
+    job.input = input;
+    job.input_len = input_len;
+    job.queued_at = span_enabled ? span_now() : 0;
+    job.state = MACHINE_RUNNING;
+    job.instructions = 0;
+    job.cycles = 0;
+    memset(job.reg, 0, sizeof(job.reg));
+    batch->jobs.push_back(job);
+}
+
+static void batch_run_each(batch_t *batch, machine_t *m, word_t *work, uint32_t mem_words)
+{
+    for(batch_job_t &job : batch->jobs)
+    {
+        uint32_t index = (uint32_t)(&job - batch->jobs.data());
+        PROBE2(job_start, index, job.input_len);
+        SPAN_END(job.queued_at, SPAN_QUEUE, index);
+        SPAN_BEGIN(begin);
+        memcpy(work, batch->init->mem, mem_words * sizeof(word_t));
+        decode_cache_t *decode = m->decode;
+        *m = *batch->init;
+        m->mem = work;
+        m->decode = decode;
+        if(decode)
+            decode_cache_reset(decode);
+        machine_set_input(m, job.input, job.input_len);
+
+        batch->executed_instructions += machine_run(m, budget(batch, m));
+        job_finish(batch, &job, m);
+        SPAN_END(begin, SPAN_JOB, index);
+    }
+}
+
+static void batch_run_tree(batch_t *batch, machine_t *m, word_t *work, uint32_t mem_words)
+{
+    std::vector<batch_node_t> stack;
+    //a job starts with the first node run that carries it.
+    std::vector<uint8_t> started(batch->jobs.size(), 0);
+
+    //snapshots always span MEM_WORDS, work is that large.
+    memcpy(work, batch->init->mem, mem_words * sizeof(word_t));
+    batch_node_t root;
+    root.machine = *batch->init;
+    root.snapshot = snapshot_take(&batch->store, work);
+    for(uint32_t j = 0; j < batch->jobs.size(); ++j)
+        root.jobs.push_back(j);
+    stack.push_back(root);
+
+    while(!stack.empty())
+    {
+        batch_node_t node = stack.back();
+        stack.pop_back();
+        //a tree node is one job span, arg counts the jobs it carries.
+        SPAN_BEGIN(begin);
+
+        snapshot_restore(&batch->store, node.snapshot, work);
+        decode_cache_t *decode = m->decode;
+        *m = node.machine;
+        m->mem = work;
+        m->decode = decode;
+        if(decode)
+            decode_cache_reset(decode);
+
+        //the group agrees on everything read so far, any job's input will do.
+        const batch_job_t &first = batch->jobs[node.jobs[0]];
+        m->input = first.input;
+        m->input_len = first.input_len;
+
+        batch_group_t group;
+        if(node.jobs.size() > 1)
+        {
+            group.batch = batch;
+            group.jobs = &node.jobs;
+            group.min_len = UINT32_MAX;
+            group.max_len = 0;
+            for(uint32_t j : node.jobs)
+            {
+                uint32_t len = batch->jobs[j].input_len;
+                group.min_len = len < group.min_len ? len : group.min_len;
+                group.max_len = len > group.max_len ? len : group.max_len;
+            }
+            group.checked_pos = m->input_pos;
+            group.pc_step = m->isa == ISA_LC3B ? lc3b_isa_t::pc_step : lc3_isa_t::pc_step;
+            m->on_input = group_on_input;
+            m->input_ctx = &group;
+        }
+        else
+        {
+            m->on_input = 0;
+            m->input_ctx = 0;
+        }
+
+        for(uint32_t j : node.jobs)
+        {
+            if(started[j])
+                continue;
+            started[j] = 1;
+            PROBE2(job_start, j, batch->jobs[j].input_len);
+            SPAN_END(batch->jobs[j].queued_at, SPAN_QUEUE, j);
+        }
+
+        batch->executed_instructions += machine_run(m, budget(batch, m));
+        m->on_input = 0;
+        m->input_ctx = 0;
+
+        if(m->state != MACHINE_INPUT)
+        {
+            for(uint32_t j : node.jobs)
+                job_finish(batch, &batch->jobs[j], m);
+            snapshot_release(&batch->store, node.snapshot);
+            SPAN_END(begin, SPAN_JOB, (uint32_t)node.jobs.size());
+            continue;
+        }
+
+        //fork one child per answer at the refused instruction.
+        group_rollback(&group, m);
+        snapshot_id_t fork = snapshot_take(&batch->store, work);
+        std::map<uint32_t, std::vector<uint32_t> > children;
+        for(uint32_t j : node.jobs)
+            children[job_answer(&batch->jobs[j], group.kind, m->input_pos)].push_back(j);
+
+        for(auto &entry : children)
+        {
+            batch_node_t child;
+            child.machine = *m;
+            child.snapshot = fork;
+            child.jobs.swap(entry.second);
+            snapshot_retain(&batch->store, fork);
+            stack.push_back(child);
+            ++batch->forks;
+        }
+        snapshot_release(&batch->store, fork);
+        snapshot_release(&batch->store, node.snapshot);
+        SPAN_END(begin, SPAN_JOB, (uint32_t)node.jobs.size());
+    }
+}
+
+void batch_run(batch_t *batch)
+{
+    uint32_t mem_words = batch->init->isa == ISA_LC3B ? lc3b_isa_t::mem_words : lc3_isa_t::mem_words;
+    word_t *work = new word_t[MEM_WORDS]();
+
+    machine_t *m = new machine_t();
+    decode_cache_t *decode = 0;
+    if(batch->decode_store)
+    {
+        decode = new decode_cache_t();
+        decode_cache_init(decode, batch->decode_store, batch->init->isa, batch->image_hash);
+    }
+    m->decode = decode;
+
+    batch->executed_instructions = 0;
+    batch->forks = 0;
+    if(batch->share_prefix && !batch->jobs.empty())
+        batch_run_tree(batch, m, work, mem_words);
+    else
+        batch_run_each(batch, m, work, mem_words);
+
+    if(decode)
+    {
+        decode_cache_destroy(decode);
+        delete decode;
+    }
+    delete m;
+    delete[] work;
+}
+
+void batch_run_archive(const machine_t *init, const tar_archive_t *archive,
+                       const uint8_t *input, uint32_t input_len, uint64_t max_instructions,
+                       std::vector<batch_job_t> *results)
+{
+    uint32_t mem_words = init->isa == ISA_LC3B ? lc3b_isa_t::mem_words : lc3_isa_t::mem_words;
+    word_t *work = new word_t[MEM_WORDS]();
+    machine_t *m = new machine_t();
+
+    results->resize(archive->members.size());
+    for(uint32_t i = 0; i < archive->members.size(); ++i)
+    {
+        batch_job_t &job = (*results)[i];
+        job.input = input;
+        job.input_len = input_len;
+        job.queued_at = 0;
+        PROBE2(job_start, i, input_len);
+        SPAN_BEGIN(begin);
+
+        memcpy(work, init->mem, mem_words * sizeof(word_t));
+        *m = *init;
+        m->mem = work;
+        m->decode = 0;
+        if(!tar_load(&archive->members[i], m))
+        {
+            m->state = MACHINE_FAULT;
+            m->output.clear();
+        }
+        else
+        {
+            machine_set_input(m, input, input_len);
+            machine_run(m, max_instructions);
+        }
+
+        PROBE3(job_end, i, (uint32_t)m->state, m->instructions);
+        job.state = m->state;
+        job.instructions = m->instructions;
+        job.cycles = m->cycles;
+        memcpy(job.reg, m->reg, sizeof(job.reg));
+        job.output.swap(m->output);
+        SPAN_END(begin, SPAN_JOB, i);
+    }
+
+    delete m;
+    delete[] work;
+}
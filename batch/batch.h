@@ -0,0 +1,70 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include<vector>
+
+#include"../type/type.h"
+#include"../engine/machine.h"
+#include"../engine/decode_cache.h"
+#include"../snapshot/page_store.h"
+#include"../archive/tar.h"
+
+//one run of the batch program on its own keyboard input.
+struct batch_job_t
+{
+    const uint8_t *input;
+    uint32_t input_len;
+    //span_now() when the job was added, the start of its queue span.
+    uint64_t queued_at;
+
+    //filled by batch_run.
+    machine_state_t state;
+    uint64_t instructions;
+    uint64_t cycles;
+    reg_t reg[0x8];
+    std::vector<uint8_t> output;
+};
+
+struct batch_t
+{
+    //every job starts from this machine, its mem is left untouched.
+    const machine_t *init;
+    std::vector<batch_job_t> jobs;
+    uint64_t max_instructions;
+
+    //run common prefixes once and fork at input dependent reads.
+    bool share_prefix;
+    //optional, shared decoded pages for every job.
+    decode_store_t *decode_store;
+    uint64_t image_hash;
+
+    //host work, to compare against the sum of job instructions.
+    uint64_t executed_instructions;
+    uint32_t forks;
+    page_store_t store;
+};
+
+void batch_init(batch_t *batch, const machine_t *init, uint64_t max_instructions);
+
+void batch_add_job(batch_t *batch, const uint8_t *input, uint32_t input_len);
+
+/*
+function define:
+    jobs that have read the same input behave the same, so a group of jobs
+    runs as one machine until the first KBSR, KBDR, GETC or IN whose answer
+    differs inside the group, there the machine is snapshot and one child
+    group is forked per answer, deeper forks build a tree
+*/
+void batch_run(batch_t *batch);
+
+/*
+function define:
+    one result per member of archive, each member is loaded straight from the
+    mapping into a copy of init and run on the same input
+    members that do not load end in MACHINE_FAULT without instructions
+*/
+void batch_run_archive(const machine_t *init, const tar_archive_t *archive,
+                       const uint8_t *input, uint32_t input_len, uint64_t max_instructions,
+                       std::vector<batch_job_t> *results);
+
+#endif //BATCH_H
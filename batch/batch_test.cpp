@@ -0,0 +1,96 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"batch.h"
+#include"../test/check.h"
+
+//ADD R1,R1,#5; GETC; OUT; GETC; OUT; HALT.
+static const uint8_t program[] =
+{
+    0x30, 0x00,
+    0x12, 0x65, 0xF0, 0x20, 0xF0, 0x21, 0xF0, 0x20, 0xF0, 0x21, 0xF0, 0x25
+};
+
+static const char *inputs[] = {"ab", "ac", "xb", "ab", "a"};
+#define INPUT_COUNT 5
+
+//enable keyboard interrupts and count in R1, the handler at x3100 echoes KBDR.
+static const word_t main_code[] =
+{
+    0x2C0F, 0x200F, 0xB00F, 0x1261, 0x0FFE, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x3000, 0x4000, 0xFE00
+};
+static const word_t handler_code[] = {0xA003, 0xF021, 0x16E1, 0x8000, 0xFE02};
+
+static const char *interrupt_inputs[] = {"ab", "", "ax", "b", ""};
+
+static void run(const machine_t *init, bool share_prefix, const char **inputs,
+                std::vector<batch_job_t> *jobs, uint32_t *forks)
+{
+    batch_t *batch = new batch_t();
+    batch_init(batch, init, 1000);
+    batch->share_prefix = share_prefix;
+    for(int i = 0; i < INPUT_COUNT; ++i)
+        batch_add_job(batch, (const uint8_t *)inputs[i], (uint32_t)strlen(inputs[i]));
+    batch_run(batch);
+    *jobs = batch->jobs;
+    *forks = batch->forks;
+    delete batch;
+}
+
+static void check_same(const std::vector<batch_job_t> &tree, const std::vector<batch_job_t> &each)
+{
+    for(int i = 0; i < INPUT_COUNT; ++i)
+    {
+        CHECK(tree[i].state == each[i].state);
+        CHECK(tree[i].instructions == each[i].instructions);
+        CHECK(tree[i].cycles == each[i].cycles);
+        CHECK(!memcmp(tree[i].reg, each[i].reg, sizeof(tree[i].reg)));
+        CHECK(tree[i].output == each[i].output);
+    }
+}
+
+int main()
+{
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    machine_t *init = new machine_t();
+    machine_init(init, ISA_LC3, mem.data());
+    machine_load_obj(init, program, sizeof(program));
+
+    std::vector<batch_job_t> each;
+    std::vector<batch_job_t> tree;
+    uint32_t each_forks = 0;
+    uint32_t tree_forks = 0;
+    run(init, false, inputs, &each, &each_forks);
+    run(init, true, inputs, &tree, &tree_forks);
+
+    //forking the shared prefix gives every job what running it alone gives.
+    CHECK(each_forks == 0 && tree_forks > 0);
+    check_same(tree, each);
+    for(int i = 0; i < INPUT_COUNT; ++i)
+        CHECK(tree[i].reg[1] == 5);
+    CHECK(tree[0].state == MACHINE_HALTED && tree[0].output.size() >= 2);
+    CHECK(tree[0].output[0] == 'a' && tree[0].output[1] == 'b');
+    CHECK(tree[2].output[0] == 'x' && tree[2].output[1] == 'b');
+    //the short input waits on the second GETC.
+    CHECK(tree[4].state == MACHINE_BLOCKED && tree[4].output.size() == 1);
+    //the original image is left alone.
+    CHECK(mem[0x3000] == 0x1265 && init->reg[1] == 0);
+
+    //jobs without input never take the keyboard interrupt, the group forks on it.
+    std::vector<word_t> interrupt_mem(UINT16_MAX, 0);
+    machine_init(init, ISA_LC3, interrupt_mem.data());
+    memcpy(&interrupt_mem[0x3000], main_code, sizeof(main_code));
+    memcpy(&interrupt_mem[0x3100], handler_code, sizeof(handler_code));
+    interrupt_mem[0x0180] = 0x3100;
+    run(init, false, interrupt_inputs, &each, &each_forks);
+    run(init, true, interrupt_inputs, &tree, &tree_forks);
+    check_same(tree, each);
+    CHECK(each[0].output.size() == 2 && each[0].output[0] == 'a' && each[0].output[1] == 'b');
+    CHECK(each[1].output.empty() && each[1].reg[3] == 0);
+    CHECK(each[3].output.size() == 1 && each[3].reg[3] == 1);
+
+    delete init;
+    return check_result();
+}
@@ -0,0 +1,177 @@
+#include<string.h>
+
+#include"decode_cache.h"
+#include"engine.h"
+#include"../probe/probe.h"
+#include"../profile/span.h"
+
+static uint64_t store_key(uint64_t image_hash, page_hash_t hash, isa_variant_t isa)
+{
+    return (hash ^ (image_hash * 0x9E3779B97F4A7C15ULL)) + isa;
+}
+
+//words of mem held by page p.
+static uint32_t decode_page_words(isa_variant_t isa, uint32_t p)
+{
+    uint32_t mem_words = isa == ISA_LC3B ? lc3b_isa_t::mem_words : lc3_isa_t::mem_words;
+    uint32_t begin = p * PAGE_WORDS;
+    if(begin >= mem_words)
+        return 0;
+    return mem_words - begin < PAGE_WORDS ? mem_words - begin : PAGE_WORDS;
+}
+
+void decode_store_init(decode_store_t *store)
+{
+    pthread_mutex_init(&store->lock, 0);
+    store->pages.clear();
+    store->hits = 0;
+    store->misses = 0;
+}
+
+void decode_store_destroy(decode_store_t *store)
+{
+    for(auto &entry : store->pages)
+        delete entry.second;
+    store->pages.clear();
+    pthread_mutex_destroy(&store->lock);
+}
+
+void decode_cache_init(decode_cache_t *cache, decode_store_t *store, isa_variant_t isa, uint64_t image_hash)
+{
+    cache->store = store;
+    cache->image_hash = image_hash;
+    cache->isa = isa;
+    cache->decode_fn = isa == ISA_LC3B ? decode_page<lc3b_isa_t> : decode_page<lc3_isa_t>;
+    memset(cache->page, 0, sizeof(cache->page));
+    memset(cache->overlay, 0, sizeof(cache->overlay));
+    cache->overlay_pages = 0;
+    cache->generation = 0;
+}
+
+void decode_cache_destroy(decode_cache_t *cache)
+{
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        delete[] cache->overlay[p];
+        cache->overlay[p] = 0;
+        cache->page[p] = 0;
+    }
+    cache->overlay_pages = 0;
+}
+
+void decode_cache_reset(decode_cache_t *cache)
+{
+    //overlays stay allocated for reuse.
+    memset(cache->page, 0, sizeof(cache->page));
+    cache->overlay_pages = 0;
+}
+
+static decode_page_t *store_find(decode_store_t *store, uint64_t key, uint64_t image_hash,
+                                 isa_variant_t isa, const word_t *words, uint32_t count)
+{
+    auto range = store->pages.equal_range(key);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        decode_page_t *page = it->second;
+        if(page->image_hash == image_hash && page->isa == isa &&
+           memcmp(page->words, words, count * sizeof(word_t)) == 0)
+            return page;
+    }
+    return 0;
+}
+
+decoded_t *decode_cache_fill(decode_cache_t *cache, const word_t *mem, uint32_t p)
+{
+    SPAN_BEGIN(begin);
+    const word_t *words = mem + p * PAGE_WORDS;
+    uint32_t count = decode_page_words(cache->isa, p);
+    page_hash_t hash = page_hash(words, count);
+    uint64_t key = store_key(cache->image_hash, hash, cache->isa);
+    decode_store_t *store = cache->store;
+
+    pthread_mutex_lock(&store->lock);
+    decode_page_t *page = store_find(store, key, cache->image_hash, cache->isa, words, count);
+    if(page)
+        ++store->hits;
+    pthread_mutex_unlock(&store->lock);
+    bool published = false;
+
+    if(!page)
+    {
+        //decode outside the lock, a racing machine may publish the same page first.
+        decode_page_t *fresh = new decode_page_t();
+        fresh->image_hash = cache->image_hash;
+        fresh->hash = hash;
+        fresh->isa = cache->isa;
+        memcpy(fresh->words, words, count * sizeof(word_t));
+        //the block count falls out of the decode, the probe costs nothing unattached.
+        uint32_t blocks = cache->decode_fn(fresh->words, PAGE_WORDS, fresh->inst);
+        PROBE2(translate, p, blocks);
+
+        pthread_mutex_lock(&store->lock);
+        page = store_find(store, key, cache->image_hash, cache->isa, words, count);
+        if(page)
+        {
+            ++store->hits;
+        }
+        else
+        {
+            page = fresh;
+            fresh = 0;
+            published = true;
+            store->pages.insert({key, page});
+            ++store->misses;
+        }
+        pthread_mutex_unlock(&store->lock);
+        delete fresh;
+    }
+
+    PROBE2(decode_page, p, published);
+    //published pages are never written, the cast only lets page[] also hold overlays.
+    cache->page[p] = (decoded_t *)page->inst;
+    SPAN_END(begin, SPAN_TRANSLATE, p);
+    return cache->page[p];
+}
+
+void decode_cache_warm(decode_cache_t *cache, const word_t *mem, const uint8_t *code_pages, uint32_t page_count)
+{
+    SPAN_BEGIN(begin);
+    uint32_t filled = 0;
+    for(uint32_t p = 0; p < page_count && p < PAGE_COUNT; ++p)
+    {
+        if(code_pages[p] && !cache->page[p] && decode_page_words(cache->isa, p))
+        {
+            decode_cache_fill(cache, mem, p);
+            ++filled;
+        }
+    }
+    SPAN_END(begin, SPAN_DECODE_WARM, filled);
+}
+
+void decode_cache_write(decode_cache_t *cache, uint32_t idx, word_t value)
+{
+    uint32_t p = idx >> 8;
+    if(cache->page[p] != cache->overlay[p])
+    {
+        //first write to a shared page, switch to a private copy.
+        if(!cache->overlay[p])
+            cache->overlay[p] = new decoded_t[PAGE_WORDS];
+        memcpy(cache->overlay[p], cache->page[p], PAGE_WORDS * sizeof(decoded_t));
+        cache->page[p] = cache->overlay[p];
+        ++cache->overlay_pages;
+    }
+    decoded_t *inst = cache->page[p];
+    uint32_t i = idx & 0xFF;
+    cache->decode_fn(&value, 1, &inst[i]);
+    PROBE2(translate, p, 1);
+    ++cache->generation;
+
+    //block lengths up to the previous block end follow the new word.
+    if(!(inst[i].flags & DECODED_ENDS_BLOCK) && i + 1 < PAGE_WORDS)
+        inst[i].block_len = inst[i + 1].block_len + 1;
+    while(i > 0 && !(inst[i - 1].flags & DECODED_ENDS_BLOCK))
+    {
+        --i;
+        inst[i].block_len = inst[i + 1].block_len + 1;
+    }
+}
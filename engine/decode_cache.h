@@ -0,0 +1,94 @@
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include<pthread.h>
+#include<unordered_map>
+
+#include"../type/type.h"
+#include"../snapshot/page_store.h"
+#include"isa.h"
+
+struct machine_t;
+struct decoded_t;
+
+typedef void (*handler_t)(machine_t *m, const decoded_t *d);
+
+//an instruction with its fields extracted and its offset extended and scaled.
+struct decoded_t
+{
+    handler_t handler;
+    word_t ir;
+    word_t imm;
+    uint8_t dr;
+    uint8_t sr1;
+    uint8_t sr2;
+    uint8_t flags;
+    //instructions from here to the end of the translated block, this one included.
+    //a block ends at a control transfer or at the end of the page.
+    uint16_t block_len;
+};
+
+//IR[5] of ADD, AND, XOR and IR[11] of JSR.
+#define DECODED_IMM 0x01
+//the operation ends a block, see op_ends_block.
+#define DECODED_ENDS_BLOCK 0x80
+
+typedef uint32_t (*decode_page_fn_t)(const word_t *words, uint32_t count, decoded_t *out);
+
+//a decoded page, immutable once published in the store.
+struct decode_page_t
+{
+    uint64_t image_hash;
+    page_hash_t hash;
+    isa_variant_t isa;
+    word_t words[PAGE_WORDS];
+    decoded_t inst[PAGE_WORDS];
+};
+
+//shared by every machine and thread, keyed by (image hash, page content hash).
+struct decode_store_t
+{
+    pthread_mutex_t lock;
+    std::unordered_multimap<uint64_t, decode_page_t *> pages;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/*
+per machine view:
+    page[p] points into the shared store until the machine writes page p,
+    then at its private overlay, a copy with the written words decoded again
+*/
+struct decode_cache_t
+{
+    decode_store_t *store;
+    uint64_t image_hash;
+    isa_variant_t isa;
+    decode_page_fn_t decode_fn;
+
+    decoded_t *page[PAGE_COUNT];
+    decoded_t *overlay[PAGE_COUNT];
+    uint32_t overlay_pages;
+    //bumped by every decode_cache_write, a running block stops when it changes.
+    uint32_t generation;
+};
+
+void decode_store_init(decode_store_t *store);
+void decode_store_destroy(decode_store_t *store);
+
+void decode_cache_init(decode_cache_t *cache, decode_store_t *store, isa_variant_t isa, uint64_t image_hash);
+void decode_cache_destroy(decode_cache_t *cache);
+
+//forget every page, needed after mem is changed outside the engine (load, restore).
+void decode_cache_reset(decode_cache_t *cache);
+
+//map page p of mem, from the store or decoded and published.
+decoded_t *decode_cache_fill(decode_cache_t *cache, const word_t *mem, uint32_t p);
+
+//map the flagged pages ahead of the run, code_pages as from image_code_pages.
+void decode_cache_warm(decode_cache_t *cache, const word_t *mem, const uint8_t *code_pages, uint32_t page_count);
+
+//the machine stored value at word idx of a mapped page.
+void decode_cache_write(decode_cache_t *cache, uint32_t idx, word_t value);
+
+#endif //DECODE_CACHE_H
@@ -0,0 +1,55 @@
+#include<stdio.h>
+#include<vector>
+
+#include"decode_cache.h"
+#include"engine.h"
+#include"../test/check.h"
+
+int main()
+{
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    //ADD R0,R0,#1 three times, BRnzp back to the first.
+    const word_t code[4] = {0x1021, 0x1021, 0x1021, 0x0FFC};
+    for(int i = 0; i < 4; ++i)
+        mem[0x3000 + i] = code[i];
+
+    decode_store_t store;
+    decode_store_init(&store);
+    decode_cache_t *a = new decode_cache_t();
+    decode_cache_t *b = new decode_cache_t();
+    decode_cache_init(a, &store, ISA_LC3, 1);
+    decode_cache_init(b, &store, ISA_LC3, 1);
+
+    //the second machine finds the page the first one published.
+    decoded_t *page_a = decode_cache_fill(a, mem.data(), 0x30);
+    decoded_t *page_b = decode_cache_fill(b, mem.data(), 0x30);
+    CHECK(page_a == page_b);
+    CHECK(store.misses == 1 && store.hits == 1);
+    CHECK(page_a[0].block_len == 4 && page_a[3].block_len == 1);
+    CHECK(page_a[0].handler == (handler_t)execute<lc3_isa_t, OP_ADD>);
+
+    //a write moves b to a private copy and leaves a alone.
+    uint32_t generation = b->generation;
+    decode_cache_write(b, 0x3001, 0x0FFE);
+    CHECK(b->page[0x30] != page_a && b->overlay_pages == 1);
+    CHECK(b->generation != generation);
+    CHECK(b->page[0x30][1].handler == (handler_t)execute<lc3_isa_t, OP_BR>);
+    CHECK(b->page[0x30][0].block_len == 2 && b->page[0x30][2].block_len == 2);
+    CHECK(page_a[1].handler == (handler_t)execute<lc3_isa_t, OP_ADD> && page_a[0].block_len == 4);
+
+    //another image or variant never shares the page.
+    decode_cache_t *c = new decode_cache_t();
+    decode_cache_init(c, &store, ISA_LC3, 2);
+    CHECK(decode_cache_fill(c, mem.data(), 0x30) != page_a);
+    CHECK(store.misses == 2);
+
+    decode_cache_destroy(a);
+    decode_cache_destroy(b);
+    decode_cache_destroy(c);
+    delete a;
+    delete b;
+    delete c;
+    decode_store_destroy(&store);
+
+    return check_result();
+}
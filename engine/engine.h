@@ -0,0 +1,643 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include"../type/type.h"
+#include"../mem/address.h"
+#include"isa.h"
+#include"machine.h"
+#include"decode_cache.h"
+#include"../profile/interval.h"
+#include"../profile/latency.h"
+#include"../probe/probe.h"
+
+//the functional interpreter, specialised per variant trait.
+//isa_t is resolved at compile time, the hot path holds no variant checks.
+
+inline word_t sign_extend(word_t value, int bits)
+{
+    return (word_t)((int16_t)(value << (16 - bits)) >> (16 - bits));
+}
+
+#define IR_DR(ir) (((ir) >> 9) & 0x7)
+#define IR_SR1(ir) (((ir) >> 6) & 0x7)
+#define IR_SR2(ir) ((ir) & 0x7)
+
+inline void set_cc(machine_t *m, word_t value)
+{
+    word_t cc = value == 0 ? PSR_Z : (value & 0x8000) ? PSR_N : PSR_P;
+    m->psr = (m->psr & ~PSR_CC) | cc;
+}
+
+template<typename isa_t>
+inline word_t mem_read(machine_t *m, word_t addr)
+{
+    if(addr >= DEVICE_REGISTER_ADDR)
+        return device_read(m, addr & ~(isa_t::pc_step - 1));
+    if constexpr(isa_t::byte_addressed)
+        return m->mem[addr >> 1];
+    else
+        return m->mem[addr];
+}
+
+template<typename isa_t>
+inline void mem_write(machine_t *m, word_t addr, word_t value)
+{
+    if(addr >= DEVICE_REGISTER_ADDR)
+    {
+        device_write(m, addr & ~(isa_t::pc_step - 1), value);
+        return;
+    }
+    if(m->write_watch && WATCHED(m->write_watch, addr))
+        m->on_write(m, addr, value, m->write_ctx);
+    uint32_t idx = addr >> isa_t::offset_shift;
+    m->mem[idx] = value;
+    //self modifying or data store into a decoded page.
+    if(m->decode && m->decode->page[idx >> 8])
+        decode_cache_write(m->decode, idx, value);
+}
+
+//byte access, only the byte addressed variant uses it.
+template<typename isa_t>
+inline uint8_t mem_read_byte(machine_t *m, word_t addr)
+{
+    word_t word = mem_read<isa_t>(m, addr);
+    return (uint8_t)((addr & 1) ? word >> 8 : word);
+}
+
+template<typename isa_t>
+inline void mem_write_byte(machine_t *m, word_t addr, uint8_t value)
+{
+    if(addr >= DEVICE_REGISTER_ADDR)
+    {
+        device_write(m, addr & ~1, value);
+        return;
+    }
+    if(m->write_watch && WATCHED(m->write_watch, addr))
+        m->on_write(m, addr, value, m->write_ctx);
+    uint32_t idx = addr >> 1;
+    word_t &word = m->mem[idx];
+    word = (addr & 1) ? (word_t)((word & 0x00FF) | (value << 8))
+                      : (word_t)((word & 0xFF00) | value);
+    if(m->decode && m->decode->page[idx >> 8])
+        decode_cache_write(m->decode, idx, word);
+}
+
+template<typename isa_t>
+inline void push(machine_t *m, word_t value)
+{
+    m->reg[6] -= isa_t::pc_step;
+    mem_write<isa_t>(m, m->reg[6], value);
+}
+
+template<typename isa_t>
+inline word_t pop(machine_t *m)
+{
+    word_t value = mem_read<isa_t>(m, m->reg[6]);
+    m->reg[6] += isa_t::pc_step;
+    return value;
+}
+
+/*
+function define:
+    enter supervisor mode, push PSR and PC on the supervisor stack,
+    PC <- interrupt vector table [vector]
+*/
+template<typename isa_t>
+inline void engine_interrupt(machine_t *m, uint8_t vector, word_t priority)
+{
+    word_t handler = mem_read<isa_t>(m, isa_t::interrupt_table + (vector << isa_t::offset_shift));
+    if(handler == 0)
+    {
+        m->state = MACHINE_FAULT;
+        return;
+    }
+    word_t psr = m->psr;
+    if(psr & PSR_PRIVILEGE)
+    {
+        m->saved_usp = m->reg[6];
+        m->reg[6] = m->saved_ssp;
+    }
+    PROBE3(interrupt, vector, priority, m->pc);
+    LATENCY_TAKE(m, vector, priority, handler);
+    push<isa_t>(m, psr);
+    push<isa_t>(m, m->pc);
+    m->psr = (psr & ~(PSR_PRIVILEGE | PSR_PRIORITY)) | (priority << 8);
+    m->pc = handler;
+}
+
+/*
+function define:
+    service a trap whose vector table entry is empty,
+    R7 is already set as for a routine in memory
+*/
+template<typename isa_t>
+inline void engine_trap_native(machine_t *m, uint8_t vector)
+{
+    switch(vector)
+    {
+    case GETC:
+    case IN:
+        if(m->on_input && !m->on_input(m, INPUT_BYTE, m->input_ctx))
+        {
+            m->state = MACHINE_INPUT;
+            return;
+        }
+        if(m->input_pos >= m->input_len)
+        {
+            //retry the TRAP once input arrives.
+            m->pc -= isa_t::pc_step;
+            m->state = MACHINE_BLOCKED;
+            return;
+        }
+        if(vector == IN)
+        {
+            for(const char *s = "\nInput a character> "; *s; ++s)
+                device_output(m, (uint8_t)*s);
+        }
+        LATENCY_LOWER(m, LATENCY_KEYBOARD);
+        if(m->input_pos + 1 < m->input_len && (m->kbsr & KBSR_IE))
+            LATENCY_RAISE(m, LATENCY_KEYBOARD);
+        m->reg[0] = m->input[m->input_pos++];
+        if(vector == IN)
+            device_output(m, (uint8_t)m->reg[0]);
+        break;
+    case OUT:
+        device_output(m, (uint8_t)m->reg[0]);
+        break;
+    case PUTS:
+        if constexpr(isa_t::byte_addressed)
+        {
+            for(word_t addr = m->reg[0]; uint8_t c = mem_read_byte<isa_t>(m, addr); ++addr)
+                device_output(m, c);
+        }
+        else
+        {
+            for(word_t addr = m->reg[0]; word_t w = mem_read<isa_t>(m, addr); ++addr)
+                device_output(m, (uint8_t)w);
+        }
+        break;
+    case PUTSP:
+        if constexpr(isa_t::byte_addressed)
+        {
+            for(word_t addr = m->reg[0]; uint8_t c = mem_read_byte<isa_t>(m, addr); ++addr)
+                device_output(m, c);
+        }
+        else
+        {
+            for(word_t addr = m->reg[0]; word_t w = mem_read<isa_t>(m, addr); ++addr)
+            {
+                device_output(m, (uint8_t)w);
+                if(!(w >> 8))
+                    break;
+                device_output(m, (uint8_t)(w >> 8));
+            }
+        }
+        break;
+    case HALT:
+        m->state = MACHINE_HALTED;
+        break;
+    default:
+        m->state = MACHINE_FAULT;
+        break;
+    }
+}
+
+/*
+function define:
+    extract the fields of IR, extend and scale the offset of op
+*/
+template<typename isa_t, op_t op>
+inline void execute(machine_t *m, const decoded_t *d);
+
+template<typename isa_t, op_t op>
+inline decoded_t decode(word_t ir)
+{
+    const int shift = isa_t::offset_shift;
+    decoded_t d;
+    d.handler = execute<isa_t, op>;
+    d.ir = ir;
+    d.imm = 0;
+    d.dr = IR_DR(ir);
+    d.sr1 = IR_SR1(ir);
+    d.sr2 = IR_SR2(ir);
+    d.flags = 0;
+
+    if constexpr(op == OP_BR || op == OP_LEA || op == OP_LD || op == OP_LDI || op == OP_ST || op == OP_STI)
+    {
+        d.imm = (word_t)(sign_extend(ir, 9) << shift);
+    }
+    else if constexpr(op == OP_ADD || op == OP_AND || op == OP_XOR)
+    {
+        d.flags = (ir & 0x0020) ? DECODED_IMM : 0;
+        d.imm = sign_extend(ir, 5);
+    }
+    else if constexpr(op == OP_SHF)
+    {
+        d.flags = (ir >> 4) & 0x3;
+        d.imm = ir & 0xF;
+    }
+    else if constexpr(op == OP_LDR || op == OP_STR || op == OP_LDW || op == OP_STW)
+    {
+        d.imm = (word_t)(sign_extend(ir, 6) << shift);
+    }
+    else if constexpr(op == OP_LDB || op == OP_STB)
+    {
+        d.imm = sign_extend(ir, 6);
+    }
+    else if constexpr(op == OP_JSR)
+    {
+        d.flags = (ir & 0x0800) ? DECODED_IMM : 0;
+        d.imm = (word_t)(sign_extend(ir, 11) << shift);
+    }
+    else if constexpr(op == OP_TRAP)
+    {
+        d.imm = ir & 0xFF;
+    }
+    d.block_len = 1;
+    if(op_ends_block[op])
+        d.flags |= DECODED_ENDS_BLOCK;
+    return d;
+}
+
+template<typename isa_t, op_t op>
+inline void execute(machine_t *m, const decoded_t *d)
+{
+    if constexpr(op == OP_BR)
+    {
+        //d->dr holds nzp.
+        if(d->dr & m->psr & PSR_CC)
+            m->pc += d->imm;
+    }
+    else if constexpr(op == OP_ADD || op == OP_AND || op == OP_XOR)
+    {
+        word_t a = m->reg[d->sr1];
+        word_t b = (d->flags & DECODED_IMM) ? d->imm : m->reg[d->sr2];
+        word_t r = op == OP_ADD ? (word_t)(a + b) : op == OP_AND ? (word_t)(a & b) : (word_t)(a ^ b);
+        m->reg[d->dr] = r;
+        set_cc(m, r);
+    }
+    else if constexpr(op == OP_NOT)
+    {
+        word_t r = ~m->reg[d->sr1];
+        m->reg[d->dr] = r;
+        set_cc(m, r);
+    }
+    else if constexpr(op == OP_SHF)
+    {
+        word_t a = m->reg[d->sr1];
+        word_t r;
+        if(!(d->flags & 0x1))
+            r = (word_t)(a << d->imm);
+        else if(!(d->flags & 0x2))
+            r = (word_t)(a >> d->imm);
+        else
+            r = (word_t)((int16_t)a >> d->imm);
+        m->reg[d->dr] = r;
+        set_cc(m, r);
+    }
+    else if constexpr(op == OP_LD)
+    {
+        word_t r = mem_read<isa_t>(m, m->pc + d->imm);
+        m->reg[d->dr] = r;
+        set_cc(m, r);
+    }
+    else if constexpr(op == OP_LDI)
+    {
+        word_t r = mem_read<isa_t>(m, mem_read<isa_t>(m, m->pc + d->imm));
+        m->reg[d->dr] = r;
+        set_cc(m, r);
+    }
+    else if constexpr(op == OP_LDR || op == OP_LDW)
+    {
+        word_t r = mem_read<isa_t>(m, m->reg[d->sr1] + d->imm);
+        m->reg[d->dr] = r;
+        set_cc(m, r);
+    }
+    else if constexpr(op == OP_LDB)
+    {
+        word_t r = sign_extend(mem_read_byte<isa_t>(m, m->reg[d->sr1] + d->imm), 8);
+        m->reg[d->dr] = r;
+        set_cc(m, r);
+    }
+    else if constexpr(op == OP_LEA)
+    {
+        word_t r = m->pc + d->imm;
+        m->reg[d->dr] = r;
+        if constexpr(isa_t::lea_sets_cc)
+            set_cc(m, r);
+    }
+    else if constexpr(op == OP_ST)
+    {
+        mem_write<isa_t>(m, m->pc + d->imm, m->reg[d->dr]);
+    }
+    else if constexpr(op == OP_STI)
+    {
+        mem_write<isa_t>(m, mem_read<isa_t>(m, m->pc + d->imm), m->reg[d->dr]);
+    }
+    else if constexpr(op == OP_STR || op == OP_STW)
+    {
+        mem_write<isa_t>(m, m->reg[d->sr1] + d->imm, m->reg[d->dr]);
+    }
+    else if constexpr(op == OP_STB)
+    {
+        mem_write_byte<isa_t>(m, m->reg[d->sr1] + d->imm, (uint8_t)m->reg[d->dr]);
+    }
+    else if constexpr(op == OP_JSR)
+    {
+        word_t link = m->pc;
+        if(d->flags & DECODED_IMM)
+            m->pc += d->imm;
+        else
+            m->pc = m->reg[d->sr1];
+        m->reg[7] = link;
+    }
+    else if constexpr(op == OP_JMP)
+    {
+        m->pc = m->reg[d->sr1];
+    }
+    else if constexpr(op == OP_TRAP)
+    {
+        uint8_t vector = (uint8_t)d->imm;
+        word_t routine = mem_read<isa_t>(m, isa_t::trap_table + (vector << isa_t::offset_shift));
+        m->reg[7] = m->pc;
+        PROBE2(trap, vector, m->pc);
+        if(routine)
+            m->pc = routine;
+        else
+            engine_trap_native<isa_t>(m, vector);
+    }
+    else if constexpr(op == OP_RTI)
+    {
+        if(m->psr & PSR_PRIVILEGE)
+        {
+            engine_interrupt<isa_t>(m, PRIVILEGE_VECTOR, (m->psr & PSR_PRIORITY) >> 8);
+            return;
+        }
+        m->pc = pop<isa_t>(m);
+        m->psr = pop<isa_t>(m);
+        if(m->psr & PSR_PRIVILEGE)
+        {
+            m->saved_ssp = m->reg[6];
+            m->reg[6] = m->saved_usp;
+        }
+        //before the cycles of RTI itself, they are charged at retire.
+        LATENCY_RETURN(m);
+        //a masked request may be taken at the lower priority.
+        m->next_event = m->instructions;
+    }
+    else
+    {
+        engine_interrupt<isa_t>(m, ILLEGAL_OPCODE_VECTOR, (m->psr & PSR_PRIORITY) >> 8);
+    }
+}
+
+#define DECODE_CASE(n) \
+    case n: return decode<isa_t, isa_t::opcode_map[n]>(ir);
+
+template<typename isa_t>
+inline decoded_t decode_word(word_t ir)
+{
+    switch(ir >> 12)
+    {
+        DECODE_CASE(0x0) DECODE_CASE(0x1) DECODE_CASE(0x2) DECODE_CASE(0x3)
+        DECODE_CASE(0x4) DECODE_CASE(0x5) DECODE_CASE(0x6) DECODE_CASE(0x7)
+        DECODE_CASE(0x8) DECODE_CASE(0x9) DECODE_CASE(0xA) DECODE_CASE(0xB)
+        DECODE_CASE(0xC) DECODE_CASE(0xD) DECODE_CASE(0xE) DECODE_CASE(0xF)
+    }
+    return decode<isa_t, OP_RESERVED>(ir);
+}
+
+//returns the blocks the words split into, the last one may run on past count.
+template<typename isa_t>
+uint32_t decode_page(const word_t *words, uint32_t count, decoded_t *out)
+{
+    uint32_t blocks = 1;
+    for(uint32_t i = 0; i < count; ++i)
+        out[i] = decode_word<isa_t>(words[i]);
+    for(uint32_t i = count - 1; i-- > 0; )
+    {
+        if(!(out[i].flags & DECODED_ENDS_BLOCK))
+            out[i].block_len = out[i + 1].block_len + 1;
+        else
+            ++blocks;
+    }
+    return blocks;
+}
+
+//the condition the microcode path of an opcode branches on:
+//BEN bit 0, IR[11] bit 1, PSR[15] bit 2.
+template<typename isa_t>
+constexpr uint8_t path_condition(op_t op)
+{
+    return op == OP_BR ? 0x1 : op == OP_JSR ? 0x2 : (op == OP_RTI || op == OP_RESERVED) ? 0x4 : 0x0;
+}
+
+template<typename isa_t>
+inline bool engine_path_alt(word_t ir, word_t psr)
+{
+    static constexpr uint8_t select[16] =
+    {
+        path_condition<isa_t>(isa_t::opcode_map[0x0]), path_condition<isa_t>(isa_t::opcode_map[0x1]),
+        path_condition<isa_t>(isa_t::opcode_map[0x2]), path_condition<isa_t>(isa_t::opcode_map[0x3]),
+        path_condition<isa_t>(isa_t::opcode_map[0x4]), path_condition<isa_t>(isa_t::opcode_map[0x5]),
+        path_condition<isa_t>(isa_t::opcode_map[0x6]), path_condition<isa_t>(isa_t::opcode_map[0x7]),
+        path_condition<isa_t>(isa_t::opcode_map[0x8]), path_condition<isa_t>(isa_t::opcode_map[0x9]),
+        path_condition<isa_t>(isa_t::opcode_map[0xA]), path_condition<isa_t>(isa_t::opcode_map[0xB]),
+        path_condition<isa_t>(isa_t::opcode_map[0xC]), path_condition<isa_t>(isa_t::opcode_map[0xD]),
+        path_condition<isa_t>(isa_t::opcode_map[0xE]), path_condition<isa_t>(isa_t::opcode_map[0xF])
+    };
+    uint32_t ben = (IR_DR(ir) & psr & PSR_CC) != 0;
+    uint32_t conditions = ben | ((ir >> 10) & 0x2) | ((psr >> 13) & 0x4);
+    return conditions & select[ir >> 12];
+}
+
+/*
+function define:
+    count instruction, cycles and opcode, call the trace hook
+    psr is the PSR the instruction started with
+*/
+template<typename isa_t>
+inline void engine_retire(machine_t *m, word_t pc, word_t ir, word_t psr)
+{
+    //a TRAP waiting for input retires once it is resumed.
+    if(m->state == MACHINE_BLOCKED || m->state == MACHINE_INPUT)
+        return;
+
+    ++m->instructions;
+    m->cycles += engine_path_alt<isa_t>(ir, psr) ? m->cycle_cost_alt[ir >> 12] : m->cycle_cost[ir >> 12];
+    ++m->opcode_count[ir >> 12];
+    if(m->interval)
+        interval_record(m->interval, isa_t::opcode_map[ir >> 12], m->pc, m->instructions, m->cycles);
+    if(m->trace)
+        m->trace(m, pc, ir, m->trace_ctx);
+    LATENCY_RETIRE(m, pc);
+}
+
+#define ENGINE_CASE(n) \
+    case n: \
+    { \
+        decoded_t d = decode<isa_t, isa_t::opcode_map[n]>(ir); \
+        execute<isa_t, isa_t::opcode_map[n]>(m, &d); \
+        break; \
+    }
+
+/*
+function define:
+    IR <- M[PC], PC <- PC + pc_step
+    decode and execute IR
+*/
+template<typename isa_t>
+inline void engine_step(machine_t *m)
+{
+    word_t pc = m->pc;
+    word_t psr = m->psr;
+    word_t ir = mem_read<isa_t>(m, pc);
+    PROBE2(fetch, pc, ir);
+    m->ir = ir;
+    m->pc = pc + isa_t::pc_step;
+
+    switch(ir >> 12)
+    {
+        ENGINE_CASE(0x0) ENGINE_CASE(0x1) ENGINE_CASE(0x2) ENGINE_CASE(0x3)
+        ENGINE_CASE(0x4) ENGINE_CASE(0x5) ENGINE_CASE(0x6) ENGINE_CASE(0x7)
+        ENGINE_CASE(0x8) ENGINE_CASE(0x9) ENGINE_CASE(0xA) ENGINE_CASE(0xB)
+        ENGINE_CASE(0xC) ENGINE_CASE(0xD) ENGINE_CASE(0xE) ENGINE_CASE(0xF)
+    }
+    engine_retire<isa_t>(m, pc, ir, psr);
+}
+
+/*
+function define:
+    the instruction boundary at next_event, raise the timer when due and
+    take the highest pending request above the PSR priority, the way
+    state 18 branches to state 49 when INT is asserted
+*/
+template<typename isa_t>
+inline void engine_poll(machine_t *m)
+{
+    if(m->timer_interval && m->instructions >= m->timer_next)
+    {
+        m->timer_pending = 1;
+        LATENCY_RAISE(m, LATENCY_TIMER);
+        m->timer_next = m->instructions + m->timer_interval;
+    }
+
+    word_t priority = (m->psr & PSR_PRIORITY) >> 8;
+    uint16_t cost = m->interrupt_cost[(m->psr & PSR_PRIVILEGE) ? 1 : 0];
+    if(m->timer_pending && TIMER_PRIORITY > priority)
+    {
+        m->timer_pending = 0;
+        ++m->interrupts;
+        //INT is sampled before the cycles of taking it.
+        engine_interrupt<isa_t>(m, TIMER_VECTOR, TIMER_PRIORITY);
+        m->cycles += cost;
+    }
+    else if((m->kbsr & KBSR_IE) && KEYBOARD_PRIORITY > priority)
+    {
+        //readiness goes through on_input like a KBSR read, a refusal stops
+        //here and the boundary is polled again when the machine resumes.
+        if(m->on_input && !m->on_input(m, INPUT_INTERRUPT, m->input_ctx))
+        {
+            m->state = MACHINE_INPUT;
+            return;
+        }
+        if(m->input_pos < m->input_len)
+        {
+            ++m->interrupts;
+            engine_interrupt<isa_t>(m, KEYBOARD_VECTOR, KEYBOARD_PRIORITY);
+            m->cycles += cost;
+        }
+    }
+
+    //masked requests wait for RTI or a PSR write, both move next_event back.
+    m->next_event = m->timer_interval ? m->timer_next : UINT64_MAX;
+}
+
+/*
+function define:
+    the decoded instructions at PC come from the decode cache,
+    run the translated block at PC when it ends before stop,
+    otherwise single step the one instruction
+    inside the block only a store into a decoded page, a device access
+    that stops the machine or moves next_event ends it early
+*/
+template<typename isa_t>
+inline void engine_block(machine_t *m, uint64_t stop)
+{
+    word_t pc = m->pc;
+    if(pc >= DEVICE_REGISTER_ADDR)
+    {
+        engine_step<isa_t>(m);
+        return;
+    }
+
+    decode_cache_t *cache = m->decode;
+    uint32_t idx = pc >> isa_t::offset_shift;
+    decoded_t *page = cache->page[idx >> 8];
+    if(!page)
+        page = decode_cache_fill(cache, m->mem, idx >> 8);
+    const decoded_t *d = &page[idx & 0xFF];
+
+    //the deadline falls inside the block, step up to it one instruction at a time.
+    if(d->block_len > stop - m->instructions)
+    {
+        word_t psr = m->psr;
+        PROBE2(fetch, pc, d->ir);
+        m->ir = d->ir;
+        m->pc = pc + isa_t::pc_step;
+        d->handler(m, d);
+        engine_retire<isa_t>(m, pc, d->ir, psr);
+        return;
+    }
+
+    const decoded_t *end = d + d->block_len;
+    uint32_t generation = cache->generation;
+    for(;;)
+    {
+        word_t psr = m->psr;
+        PROBE2(fetch, pc, d->ir);
+        m->ir = d->ir;
+        m->pc = pc + isa_t::pc_step;
+        d->handler(m, d);
+        engine_retire<isa_t>(m, pc, d->ir, psr);
+        if(++d == end || m->state != MACHINE_RUNNING || cache->generation != generation ||
+           m->instructions >= m->next_event)
+            return;
+        pc = m->pc;
+    }
+}
+
+template<typename isa_t>
+inline uint64_t engine_run(machine_t *m, uint64_t max_instructions)
+{
+    uint64_t start = m->instructions;
+    uint64_t limit = start + max_instructions;
+    if(m->decode)
+    {
+        while(m->state == MACHINE_RUNNING && m->instructions < limit)
+        {
+            if(m->instructions >= m->next_event)
+            {
+                engine_poll<isa_t>(m);
+                continue;
+            }
+            //the deadline is checked once per block, on entry.
+            engine_block<isa_t>(m, m->next_event < limit ? m->next_event : limit);
+        }
+    }
+    else
+    {
+        while(m->state == MACHINE_RUNNING && m->instructions < limit)
+        {
+            if(m->instructions >= m->next_event)
+            {
+                engine_poll<isa_t>(m);
+                continue;
+            }
+            engine_step<isa_t>(m);
+        }
+    }
+    return m->instructions - start;
+}
+
+#endif //ENGINE_H
@@ -0,0 +1,104 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"decode_cache.h"
+#include"engine.h"
+#include"../test/check.h"
+
+//set R6, enable keyboard interrupts, then a 4 instruction loop counting in R1, R2 and R5.
+static const word_t main_code[] =
+{
+    0x2C0F, 0x200F, 0xB00F, 0x1261, 0x14A1, 0x1B61, 0x0FFC, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x3000, 0x4000, 0xFE00
+};
+//the keyboard handler echoes KBDR, the timer handler counts in R4.
+static const word_t keyboard_code[] = {0xA003, 0xF021, 0x16E1, 0x8000, 0xFE02};
+static const word_t timer_code[] = {0x1921, 0x8000};
+
+struct delivery_t
+{
+    word_t handler;
+    //PC the handler returns to.
+    word_t pc;
+    uint64_t instructions;
+    uint64_t cycles;
+};
+
+static void on_trace(machine_t *m, word_t pc, word_t ir, void *ctx)
+{
+    (void)ir;
+    if(pc != 0x3100 && pc != 0x3200)
+        return;
+    delivery_t delivery;
+    delivery.handler = pc;
+    delivery.pc = m->mem[m->reg[6]];
+    delivery.instructions = m->instructions;
+    delivery.cycles = m->cycles;
+    ((std::vector<delivery_t> *)ctx)->push_back(delivery);
+}
+
+static void run(bool blocks, std::vector<delivery_t> *deliveries, machine_t *out)
+{
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    memcpy(&mem[0x3000], main_code, sizeof(main_code));
+    memcpy(&mem[0x3100], keyboard_code, sizeof(keyboard_code));
+    memcpy(&mem[0x3200], timer_code, sizeof(timer_code));
+    mem[0x0180] = 0x3100;
+    mem[0x0181] = 0x3200;
+
+    decode_store_t store;
+    decode_store_init(&store);
+    decode_cache_t *cache = new decode_cache_t();
+    decode_cache_init(cache, &store, ISA_LC3, 1);
+
+    machine_t *m = new machine_t();
+    machine_init(m, ISA_LC3, mem.data());
+    m->pc = 0x3000;
+    m->decode = blocks ? cache : 0;
+    m->trace = on_trace;
+    m->trace_ctx = deliveries;
+    machine_set_input(m, (const uint8_t *)"abc", 3);
+    //7 against a 4 instruction loop puts the timer inside blocks.
+    machine_set_timer(m, 7);
+    machine_run(m, 500);
+    *out = *m;
+    out->mem = 0;
+    out->decode = 0;
+
+    delete m;
+    decode_cache_destroy(cache);
+    delete cache;
+    decode_store_destroy(&store);
+}
+
+int main()
+{
+    std::vector<delivery_t> step;
+    std::vector<delivery_t> block;
+    machine_t *step_m = new machine_t();
+    machine_t *block_m = new machine_t();
+    run(false, &step, step_m);
+    run(true, &block, block_m);
+
+    //every request is taken at the same boundary with and without blocks.
+    CHECK(step.size() == block.size());
+    for(uint32_t i = 0; i < step.size() && i < block.size(); ++i)
+    {
+        CHECK(step[i].handler == block[i].handler);
+        CHECK(step[i].pc == block[i].pc);
+        CHECK(step[i].instructions == block[i].instructions);
+        CHECK(step[i].cycles == block[i].cycles);
+    }
+    uint32_t keyboard = 0;
+    for(const delivery_t &delivery : step)
+        keyboard += delivery.handler == 0x3100;
+    CHECK(keyboard == 3 && step.size() > 40);
+    CHECK(step_m->instructions == block_m->instructions && step_m->cycles == block_m->cycles);
+    CHECK(step_m->pc == block_m->pc && !memcmp(step_m->reg, block_m->reg, sizeof(step_m->reg)));
+    CHECK(step_m->reg[3] == 3 && step_m->reg[4] == step.size() - 3);
+
+    delete step_m;
+    delete block_m;
+    return check_result();
+}
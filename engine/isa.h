@@ -0,0 +1,98 @@
+#ifndef ISA_H
+#define ISA_H
+
+#include"../type/type.h"
+#include"../mem/address.h"
+
+//operation classes, every opcode of a variant maps to one of them.
+enum op_t
+{
+    OP_BR,
+    OP_ADD,
+    OP_LD,
+    OP_ST,
+    OP_JSR,
+    OP_AND,
+    OP_LDR,
+    OP_STR,
+    OP_RTI,
+    OP_NOT,
+    OP_LDI,
+    OP_STI,
+    OP_JMP,
+    OP_LEA,
+    OP_TRAP,
+    OP_LDB,
+    OP_STB,
+    OP_LDW,
+    OP_STW,
+    OP_XOR,
+    OP_SHF,
+    OP_RESERVED,
+    OP_COUNT
+};
+
+enum isa_variant_t
+{
+    ISA_LC3,
+    ISA_LC3B
+};
+
+/*
+variant trait:
+    address unit  : byte_addressed, pc_step, offset_shift
+    opcode map    : opcode_map[IR[15:12]]
+    memory width  : mem_words of word_t backing mem
+*/
+struct lc3_isa_t
+{
+    static const isa_variant_t variant = ISA_LC3;
+
+    //one address names one word.
+    static const bool byte_addressed = false;
+    static const uint16_t pc_step = 1;
+    //PC and base relative offsets count addresses.
+    static const int offset_shift = 0;
+    static const uint32_t mem_words = UINT16_MAX;
+
+    static const bool lea_sets_cc = true;
+
+    //trap vector table and interrupt vector table entries are one word apart.
+    static const uint16_t trap_table = TRAP_VECTOR_ADDR;
+    static const uint16_t interrupt_table = INTERRUPT_VECTOR_TABLE_ADDR;
+
+    static constexpr op_t opcode_map[16] =
+    {
+        OP_BR,  OP_ADD, OP_LD,  OP_ST,
+        OP_JSR, OP_AND, OP_LDR, OP_STR,
+        OP_RTI, OP_NOT, OP_LDI, OP_STI,
+        OP_JMP, OP_RESERVED, OP_LEA, OP_TRAP
+    };
+};
+
+struct lc3b_isa_t
+{
+    static const isa_variant_t variant = ISA_LC3B;
+
+    //one address names one byte, words are little endian and aligned.
+    static const bool byte_addressed = true;
+    static const uint16_t pc_step = 2;
+    //PC and word relative offsets count words.
+    static const int offset_shift = 1;
+    static const uint32_t mem_words = 0x8000;
+
+    static const bool lea_sets_cc = false;
+
+    static const uint16_t trap_table = 0x0000;
+    static const uint16_t interrupt_table = 0x0200;
+
+    static constexpr op_t opcode_map[16] =
+    {
+        OP_BR,  OP_ADD, OP_LDB, OP_STB,
+        OP_JSR, OP_AND, OP_LDW, OP_STW,
+        OP_RTI, OP_XOR, OP_RESERVED, OP_RESERVED,
+        OP_JMP, OP_SHF, OP_LEA, OP_TRAP
+    };
+};
+
+#endif //ISA_H
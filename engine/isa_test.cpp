@@ -0,0 +1,104 @@
+#include<stdio.h>
+#include<vector>
+
+#include"engine.h"
+#include"../test/check.h"
+
+//AND R0,R0,#0; ADD R0,R0,#7; ADD R1,R0,R0; LEA R2,#-2; HALT at x3000.
+static const uint8_t program[] =
+{
+    0x30, 0x00,
+    0x50, 0x20, 0x10, 0x27, 0x12, 0x00, 0xE5, 0xFE, 0xF0, 0x25
+};
+
+template<typename isa_t>
+static void run(std::vector<word_t> &mem)
+{
+    machine_t *m = new machine_t();
+    machine_init(m, isa_t::variant, mem.data());
+    machine_load_obj(m, program, sizeof(program));
+    machine_run(m, 100);
+    CHECK(m->state == MACHINE_HALTED);
+    CHECK(m->reg[1] == 14);
+    //LEA at x3003, PC points past it, the offset counts instructions.
+    CHECK(m->reg[2] == (word_t)(0x3000 + 4 * isa_t::pc_step - 2 * isa_t::pc_step));
+    CHECK(m->instructions == 5);
+    delete m;
+}
+
+//run one instruction the way the engine does, through its decoded form.
+template<typename isa_t>
+static void step(machine_t *m, word_t ir)
+{
+    decoded_t d = decode_word<isa_t>(ir);
+    d.handler(m, &d);
+}
+
+int main()
+{
+    //opcodes the variants disagree on.
+    CHECK(lc3_isa_t::opcode_map[0x2] == OP_LD && lc3b_isa_t::opcode_map[0x2] == OP_LDB);
+    CHECK(lc3_isa_t::opcode_map[0x6] == OP_LDR && lc3b_isa_t::opcode_map[0x6] == OP_LDW);
+    CHECK(lc3_isa_t::opcode_map[0x9] == OP_NOT && lc3b_isa_t::opcode_map[0x9] == OP_XOR);
+    CHECK(lc3_isa_t::opcode_map[0xA] == OP_LDI && lc3b_isa_t::opcode_map[0xA] == OP_RESERVED);
+    CHECK(lc3_isa_t::opcode_map[0xD] == OP_RESERVED && lc3b_isa_t::opcode_map[0xD] == OP_SHF);
+
+    //decoding scales the offset of LD to bytes on LC-3b only.
+    decoded_t d = decode_word<lc3_isa_t>(0x2FFF);
+    CHECK(d.handler == (handler_t)execute<lc3_isa_t, OP_LD>);
+    CHECK(d.dr == 7 && d.imm == 0xFFFF);
+    d = decode_word<lc3b_isa_t>(0x6E41);
+    CHECK(d.handler == (handler_t)execute<lc3b_isa_t, OP_LDW>);
+    CHECK(d.dr == 7 && d.sr1 == 1 && d.imm == 2);
+    d = decode_word<lc3b_isa_t>(0x2E41);
+    CHECK(d.handler == (handler_t)execute<lc3b_isa_t, OP_LDB>);
+    CHECK(d.imm == 1);
+    d = decode_word<lc3b_isa_t>(0x927F);
+    CHECK(d.handler == (handler_t)execute<lc3b_isa_t, OP_XOR>);
+    CHECK((d.flags & DECODED_IMM) && d.imm == 0xFFFF);
+    d = decode_word<lc3b_isa_t>(0xD2D3);
+    CHECK(d.handler == (handler_t)execute<lc3b_isa_t, OP_SHF>);
+    CHECK(d.flags == 0x1 && d.imm == 3);
+    CHECK(decode_word<lc3b_isa_t>(0xA000).handler == (handler_t)execute<lc3b_isa_t, OP_RESERVED>);
+
+    //blocks end at the first control transfer.
+    word_t words[4] = {0x1021, 0x1021, 0x0FFD, 0x1021};
+    decoded_t out[4];
+    CHECK(decode_page<lc3_isa_t>(words, 4, out) == 2);
+    CHECK(out[0].block_len == 3 && out[2].block_len == 1 && (out[2].flags & DECODED_ENDS_BLOCK));
+    CHECK(out[3].block_len == 1);
+
+    std::vector<word_t> mem(lc3_isa_t::mem_words, 0);
+    machine_t *m = new machine_t();
+    machine_init(m, ISA_LC3, mem.data());
+    //LD R7,#-1, the offset counts words.
+    mem[0x3000] = 0xBEEF;
+    m->pc = 0x3001;
+    step<lc3_isa_t>(m, 0x2FFF);
+    CHECK(m->reg[7] == 0xBEEF);
+
+    //the offset of LDW is scaled to bytes, LDB is not.
+    std::vector<word_t> mem_b(lc3b_isa_t::mem_words, 0);
+    machine_init(m, ISA_LC3B, mem_b.data());
+    m->reg[1] = 0x4000;
+    mem_write<lc3b_isa_t>(m, 0x4002, 0x1234);
+    step<lc3b_isa_t>(m, 0x6E41);
+    CHECK(m->reg[7] == 0x1234);
+    step<lc3b_isa_t>(m, 0x2E43);
+    CHECK(m->reg[7] == 0x12);
+    //XOR R1,R1,#-1 and SHF R1,R3,#3 logical right.
+    m->reg[1] = 0x00F0;
+    step<lc3b_isa_t>(m, 0x927F);
+    CHECK(m->reg[1] == 0xFF0F);
+    m->reg[3] = 0x8010;
+    step<lc3b_isa_t>(m, 0xD2D3);
+    CHECK(m->reg[1] == 0x1002);
+    delete m;
+
+    mem.assign(mem.size(), 0);
+    run<lc3_isa_t>(mem);
+    mem_b.assign(mem_b.size(), 0);
+    run<lc3b_isa_t>(mem_b);
+
+    return check_result();
+}
@@ -0,0 +1,136 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"engine.h"
+#include"../test/check.h"
+
+#ifndef INTERRUPT_LATENCY
+#error latency_test needs the hooks, build it with INTERRUPT_LATENCY
+#endif
+
+//set R6, enable keyboard interrupts, then count in R1 forever.
+static const word_t main_code[] =
+{
+    0x2C07, 0x2007, 0xB007, 0x1261, 0x0FFE, 0, 0, 0,
+    0x3000, 0x4000, 0xFE00
+};
+//the keyboard handler reads KBDR and spins long enough for the timer to nest inside it.
+static const word_t keyboard_code[] = {0xA005, 0x54A0, 0x14AC, 0x14BF, 0x03FE, 0x8000, 0xFE02};
+//the timer handler counts in R4.
+static const word_t timer_code[] = {0x1921, 0x8000};
+
+//handler cycles measured from the trace hook, entered to RTI before its own cycles.
+struct expect_t
+{
+    std::vector<uint8_t> source;
+    std::vector<uint64_t> entered;
+    uint64_t count[LATENCY_SOURCES];
+    uint64_t handler[LATENCY_SOURCES];
+    uint32_t max_depth;
+};
+
+static void on_trace(machine_t *m, word_t pc, word_t ir, void *ctx)
+{
+    expect_t *e = (expect_t *)ctx;
+    if(pc == 0x3100 || pc == 0x3200)
+    {
+        e->source.push_back(pc == 0x3100 ? LATENCY_KEYBOARD : LATENCY_TIMER);
+        e->entered.push_back(m->cycles);
+        e->max_depth = e->source.size() > e->max_depth ? (uint32_t)e->source.size() : e->max_depth;
+    }
+    else if(ir == 0x8000 && !e->source.empty())
+    {
+        uint8_t source = e->source.back();
+        ++e->count[source];
+        e->handler[source] += m->cycles - m->cycle_cost[0x8] - e->entered.back();
+        e->source.pop_back();
+        e->entered.pop_back();
+    }
+}
+
+static uint64_t bucket_sum(const latency_histogram_t *h)
+{
+    uint64_t sum = 0;
+    for(int b = 0; b < LATENCY_BUCKETS; ++b)
+        sum += h->bucket[b];
+    return sum;
+}
+
+int main()
+{
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    memcpy(&mem[0x3000], main_code, sizeof(main_code));
+    memcpy(&mem[0x3100], keyboard_code, sizeof(keyboard_code));
+    memcpy(&mem[0x3200], timer_code, sizeof(timer_code));
+    mem[0x0180] = 0x3100;
+    mem[0x0181] = 0x3200;
+
+    latency_stats_t *s = new latency_stats_t();
+    latency_init(s);
+    expect_t e;
+    memset(e.count, 0, sizeof(e.count));
+    memset(e.handler, 0, sizeof(e.handler));
+    e.max_depth = 0;
+
+    machine_t *m = new machine_t();
+    machine_init(m, ISA_LC3, mem.data());
+    m->pc = 0x3000;
+    m->latency = s;
+    m->trace = on_trace;
+    m->trace_ctx = &e;
+    machine_set_input(m, (const uint8_t *)"ab", 2);
+    machine_set_timer(m, 7);
+    machine_run(m, 600);
+
+    //both keys were taken and the timer ran inside the keyboard handler.
+    CHECK(m->reg[1] > 0 && e.count[LATENCY_KEYBOARD] == 2 && e.count[LATENCY_TIMER] > 20);
+    CHECK(e.max_depth == 2);
+    CHECK(s->overflow == 0 && s->unmatched == 0 && s->depth <= 2);
+
+    const uint8_t priority[LATENCY_SOURCES] = {0, 0, KEYBOARD_PRIORITY, TIMER_PRIORITY};
+    for(uint8_t source = LATENCY_KEYBOARD; source <= LATENCY_TIMER; ++source)
+    {
+        const latency_histogram_t *d = s->device[source];
+        const latency_histogram_t *p = s->priority[priority[source]];
+        //nested RTIs close the frame of their own request.
+        CHECK(d[LATENCY_HANDLER].count == e.count[source]);
+        CHECK(d[LATENCY_HANDLER].total == e.handler[source]);
+        CHECK(d[LATENCY_TOTAL].total ==
+              d[LATENCY_PENDING].total + d[LATENCY_DISPATCH].total + d[LATENCY_HANDLER].total);
+        for(int phase = 0; phase < LATENCY_PHASES; ++phase)
+        {
+            CHECK(bucket_sum(&d[phase]) == d[phase].count);
+            CHECK(p[phase].count == d[phase].count && p[phase].total == d[phase].total);
+        }
+    }
+    //the second key waits for the first handler's RTI, masked at priority 4.
+    CHECK(s->device[LATENCY_KEYBOARD][LATENCY_PENDING].max > s->device[LATENCY_KEYBOARD][LATENCY_HANDLER].max / 2);
+    CHECK(s->priority[0][LATENCY_TOTAL].count == 0 && s->device[LATENCY_PRIVILEGE][LATENCY_TOTAL].count == 0);
+    delete m;
+
+    //requests past LATENCY_MAX_DEPTH are counted, their RTIs leave the outer frames alone.
+    latency_init(s);
+    for(uint64_t i = 0; i < LATENCY_MAX_DEPTH + 2; ++i)
+    {
+        latency_take(s, TIMER_VECTOR, TIMER_PRIORITY, 0x3200, i);
+        if(i == LATENCY_MAX_DEPTH - 1)
+            CHECK(s->entering);
+    }
+    CHECK(s->depth == LATENCY_MAX_DEPTH && s->overflow == 2 && s->entering);
+    for(uint64_t i = 0; i < LATENCY_MAX_DEPTH + 2; ++i)
+    {
+        latency_return(s, 100 + i);
+        if(i < 2)
+            CHECK(s->depth == LATENCY_MAX_DEPTH);
+    }
+    CHECK(s->depth == 0 && s->unmatched == 0);
+    CHECK(s->device[LATENCY_TIMER][LATENCY_HANDLER].count == LATENCY_MAX_DEPTH);
+    //the outermost frame, taken at 0, returns with the last RTI.
+    CHECK(s->device[LATENCY_TIMER][LATENCY_HANDLER].max == 100 + LATENCY_MAX_DEPTH + 1);
+    latency_return(s, 200);
+    CHECK(s->unmatched == 1);
+
+    delete s;
+    return check_result();
+}
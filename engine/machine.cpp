@@ -0,0 +1,181 @@
+#include<string.h>
+
+#include"machine.h"
+#include"engine.h"
+#include"microcode.h"
+#include"../profile/span.h"
+
+void machine_init(machine_t *m, isa_variant_t isa, word_t *mem)
+{
+    m->isa = isa;
+    m->state = MACHINE_RUNNING;
+    memset(m->reg, 0, sizeof(m->reg));
+    m->pc = USER_SPACE_ADDR;
+    m->ir = 0;
+    //start in supervisor mode with Z set, like PSR_15 after reset.
+    m->psr = PSR_Z;
+    m->saved_ssp = USER_SPACE_ADDR;
+    m->saved_usp = DEVICE_REGISTER_ADDR;
+    m->mcr = MCR_CLOCK;
+    m->mem = mem;
+
+    m->input = 0;
+    m->input_len = 0;
+    m->input_pos = 0;
+    m->on_input = 0;
+    m->input_ctx = 0;
+    m->output.clear();
+
+    m->kbsr = 0;
+    m->timer_interval = 0;
+    m->timer_next = 0;
+    m->timer_pending = 0;
+    m->next_event = UINT64_MAX;
+    m->interrupts = 0;
+
+    m->instructions = 0;
+    m->cycles = 0;
+    for(int i = 0; i < 16; ++i)
+    {
+        m->cycle_cost[i] = 1;
+        m->cycle_cost_alt[i] = 1;
+        m->opcode_count[i] = 0;
+    }
+    m->interrupt_cost[0] = 0;
+    m->interrupt_cost[1] = 0;
+    microcode_cycle_cost(m, microcode_lc3(), MICRO_MEM_LATENCY);
+
+    m->trace = 0;
+    m->trace_ctx = 0;
+    m->write_watch = 0;
+    m->on_write = 0;
+    m->write_ctx = 0;
+    m->interval = 0;
+    m->latency = 0;
+    m->decode = 0;
+}
+
+void machine_set_input(machine_t *m, const uint8_t *input, uint32_t len)
+{
+    m->input = input;
+    m->input_len = len;
+    m->input_pos = 0;
+    if((m->kbsr & KBSR_IE) && len)
+        LATENCY_RAISE(m, LATENCY_KEYBOARD);
+    if(m->state == MACHINE_BLOCKED)
+        m->state = MACHINE_RUNNING;
+    //the keyboard may request now.
+    m->next_event = m->instructions;
+}
+
+void machine_set_timer(machine_t *m, uint64_t interval)
+{
+    m->timer_interval = interval;
+    m->timer_next = m->instructions + interval;
+    m->timer_pending = 0;
+    m->next_event = m->instructions;
+}
+
+word_t machine_load_obj(machine_t *m, const uint8_t *data, uint32_t len)
+{
+    if(len < 2)
+        return m->pc;
+
+    word_t origin = (word_t)((data[0] << 8) | data[1]);
+    word_t addr = origin;
+    for(uint32_t i = 2; i + 1 < len; i += 2)
+    {
+        word_t word = (word_t)((data[i] << 8) | data[i + 1]);
+        if(m->isa == ISA_LC3B)
+        {
+            mem_write<lc3b_isa_t>(m, addr, word);
+            addr += lc3b_isa_t::pc_step;
+        }
+        else
+        {
+            mem_write<lc3_isa_t>(m, addr, word);
+            addr += lc3_isa_t::pc_step;
+        }
+    }
+    m->pc = origin;
+    return origin;
+}
+
+word_t device_read(machine_t *m, word_t addr)
+{
+    switch(addr)
+    {
+    case KBSR:
+        if(m->on_input && !m->on_input(m, INPUT_READY, m->input_ctx))
+        {
+            m->state = MACHINE_INPUT;
+            return 0;
+        }
+        return (m->input_pos < m->input_len ? KBSR_READY : 0) | m->kbsr;
+    case KBDR:
+        if(m->on_input && !m->on_input(m, INPUT_BYTE, m->input_ctx))
+        {
+            m->state = MACHINE_INPUT;
+            return 0;
+        }
+        if(m->input_pos >= m->input_len)
+            return 0;
+        //the next byte, if any, is a new request.
+        LATENCY_LOWER(m, LATENCY_KEYBOARD);
+        if(m->input_pos + 1 < m->input_len && (m->kbsr & KBSR_IE))
+            LATENCY_RAISE(m, LATENCY_KEYBOARD);
+        return m->input[m->input_pos++];
+    case DSR:
+        return DSR_READY;
+    case PSR:
+        return m->psr;
+    case MCR:
+        return m->mcr;
+    default:
+        return 0;
+    }
+}
+
+void device_write(machine_t *m, word_t addr, word_t value)
+{
+    switch(addr)
+    {
+    case KBSR:
+        m->kbsr = value & KBSR_IE;
+        if((m->kbsr & KBSR_IE) && m->input_pos < m->input_len)
+            LATENCY_RAISE(m, LATENCY_KEYBOARD);
+        else
+            LATENCY_LOWER(m, LATENCY_KEYBOARD);
+        m->next_event = m->instructions;
+        break;
+    case DDR:
+        device_output(m, (uint8_t)value);
+        break;
+    case PSR:
+        m->psr = value;
+        m->next_event = m->instructions;
+        break;
+    case MCR:
+        m->mcr = value;
+        if(!(value & MCR_CLOCK))
+            m->state = MACHINE_HALTED;
+        break;
+    default:
+        break;
+    }
+}
+
+void device_output(machine_t *m, uint8_t c)
+{
+    m->output.push_back(c);
+}
+
+uint64_t machine_run(machine_t *m, uint64_t max_instructions)
+{
+    SPAN_BEGIN(begin);
+    //the variant is picked once per run, never per instruction.
+    uint64_t executed = m->isa == ISA_LC3B ? engine_run<lc3b_isa_t>(m, max_instructions)
+                                           : engine_run<lc3_isa_t>(m, max_instructions);
+    SPAN_END(begin, SPAN_EXECUTE, (uint32_t)executed);
+    return executed;
+}
@@ -0,0 +1,161 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include<vector>
+
+#include"../type/type.h"
+#include"../type/trap_vector.h"
+#include"../mem/address.h"
+#include"../mem/device_register.h"
+#include"isa.h"
+
+#define PSR_PRIVILEGE 0x8000
+#define PSR_PRIORITY 0x0700
+#define PSR_N 0x0004
+#define PSR_Z 0x0002
+#define PSR_P 0x0001
+#define PSR_CC (PSR_N | PSR_Z | PSR_P)
+
+#define KBSR_READY 0x8000
+#define KBSR_IE 0x4000
+#define DSR_READY 0x8000
+#define MCR_CLOCK 0x8000
+
+//write_watch bitmap, one bit per address.
+#define WATCH_BYTES 0x2000
+#define WATCHED(watch, addr) ((watch)[(addr) >> 3] & (1 << ((addr) & 7)))
+
+//exception vectors, offsets into the interrupt vector table.
+#define PRIVILEGE_VECTOR 0x00
+#define ILLEGAL_OPCODE_VECTOR 0x01
+
+//device interrupt vectors and their priority levels.
+#define KEYBOARD_VECTOR 0x80
+#define KEYBOARD_PRIORITY 4
+#define TIMER_VECTOR 0x81
+#define TIMER_PRIORITY 6
+
+enum machine_state_t
+{
+    MACHINE_RUNNING,
+    MACHINE_HALTED,
+    //waiting in GETC or IN for keyboard input.
+    MACHINE_BLOCKED,
+    //exception with no handler in the vector table.
+    MACHINE_FAULT,
+    //on_input refused, the instruction about to observe input did not retire,
+    //or for INPUT_INTERRUPT the keyboard interrupt was not taken.
+    MACHINE_INPUT
+};
+
+enum input_kind_t
+{
+    //the ready bit of KBSR.
+    INPUT_READY,
+    //a byte through KBDR, GETC or IN.
+    INPUT_BYTE,
+    //the ready bit sampled at an instruction boundary for a keyboard interrupt,
+    //no instruction has fetched, there is nothing to roll back.
+    INPUT_INTERRUPT
+};
+
+struct machine_t;
+struct interval_stats_t;
+struct latency_stats_t;
+struct decode_cache_t;
+
+//called after every instruction with its address and encoding.
+typedef void (*trace_fn_t)(machine_t *m, word_t pc, word_t ir, void *ctx);
+//called before the machine observes input_pos of its input.
+//return false to stop in MACHINE_INPUT, the caller then rolls the instruction back,
+//except for INPUT_INTERRUPT, which is asked before any instruction.
+typedef bool (*input_fn_t)(machine_t *m, input_kind_t kind, void *ctx);
+//called before a store to an address marked in write_watch.
+typedef void (*write_fn_t)(machine_t *m, word_t addr, word_t value, void *ctx);
+
+struct machine_t
+{
+    isa_variant_t isa;
+    machine_state_t state;
+
+    reg_t reg[0x8];
+    word_t pc;
+    word_t ir;
+    word_t psr;
+    word_t saved_ssp;
+    word_t saved_usp;
+    word_t mcr;
+
+    //isa_t::mem_words words, owned by the caller.
+    word_t *mem;
+
+    //keyboard input, consumed through KBDR and the GETC and IN traps.
+    const uint8_t *input;
+    uint32_t input_len;
+    uint32_t input_pos;
+    input_fn_t on_input;
+    void *input_ctx;
+    //display output, written through DDR and the output traps.
+    std::vector<uint8_t> output;
+
+    //interrupt enable of KBSR, the keyboard requests while input is left.
+    word_t kbsr;
+    //the timer requests every timer_interval instructions, 0 is off.
+    uint64_t timer_interval;
+    uint64_t timer_next;
+    uint8_t timer_pending;
+    //no interrupt can be taken before this instruction count,
+    //engines only look at pending requests once instructions reaches it.
+    uint64_t next_event;
+    uint64_t interrupts;
+
+    uint64_t instructions;
+    uint64_t cycles;
+    //cycles charged per IR[15:12], cycle_cost_alt when the path condition
+    //holds: a taken BR, JSR rather than JSRR, RTI or reserved opcode in user mode.
+    //machine_init walks the LC-3 control store for them, LC-3b charges 1.
+    uint16_t cycle_cost[16];
+    uint16_t cycle_cost_alt[16];
+    //cycles of taking an interrupt from supervisor [0] or user [1] mode.
+    uint16_t interrupt_cost[2];
+    //profile of executed IR[15:12].
+    uint64_t opcode_count[16];
+
+    trace_fn_t trace;
+    void *trace_ctx;
+
+    const uint8_t *write_watch;
+    write_fn_t on_write;
+    void *write_ctx;
+
+    //interval statistics, counted when set.
+    interval_stats_t *interval;
+    //interrupt latency histograms, counted when set and built with INTERRUPT_LATENCY.
+    latency_stats_t *latency;
+
+    //decoded instructions, the engine fetches through it when set.
+    decode_cache_t *decode;
+};
+
+//an LC-3 machine gets its cycle costs from microcode_lc3 at MICRO_MEM_LATENCY.
+void machine_init(machine_t *m, isa_variant_t isa, word_t *mem);
+
+void machine_set_input(machine_t *m, const uint8_t *input, uint32_t len);
+
+//request TIMER_VECTOR every interval instructions from now, 0 stops the timer.
+void machine_set_timer(machine_t *m, uint64_t interval);
+
+//load a big endian .obj image, the first word is the origin.
+//return the origin, the PC is set to it.
+word_t machine_load_obj(machine_t *m, const uint8_t *data, uint32_t len);
+
+//device registers, shared by every variant.
+word_t device_read(machine_t *m, word_t addr);
+void device_write(machine_t *m, word_t addr, word_t value);
+void device_output(machine_t *m, uint8_t c);
+
+//run at most max_instructions, stop early when the machine leaves MACHINE_RUNNING.
+//return the number of instructions executed.
+uint64_t machine_run(machine_t *m, uint64_t max_instructions);
+
+#endif //MACHINE_H
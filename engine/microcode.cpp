@@ -0,0 +1,168 @@
+#include<string.h>
+
+#include"microcode.h"
+
+void control_store_load_lc3(micro_instruction_t *store)
+{
+    memset(store, 0, 0x40 * sizeof(micro_instruction_t));
+
+    //fetch, state 18 branches to 49 on INT, 32 dispatches on IR[15:12].
+    store[18] = MICRO_WORD(0, COND_INT, 33);
+    store[33] = MICRO_WORD(0, COND_R, 33);
+    store[35] = MICRO_WORD(0, COND_NONE, 32);
+    store[32] = MICRO_WORD(1, COND_NONE, 0);
+
+    //BR
+    store[0] = MICRO_WORD(0, COND_BEN, 18);
+    store[22] = MICRO_WORD(0, COND_NONE, 18);
+    //ADD, AND, NOT, LEA, JMP
+    store[1] = MICRO_WORD(0, COND_NONE, 18);
+    store[5] = MICRO_WORD(0, COND_NONE, 18);
+    store[9] = MICRO_WORD(0, COND_NONE, 18);
+    store[14] = MICRO_WORD(0, COND_NONE, 18);
+    store[12] = MICRO_WORD(0, COND_NONE, 18);
+    //LD, LDR, LDI
+    store[2] = MICRO_WORD(0, COND_NONE, 25);
+    store[6] = MICRO_WORD(0, COND_NONE, 25);
+    store[10] = MICRO_WORD(0, COND_NONE, 24);
+    store[24] = MICRO_WORD(0, COND_R, 24);
+    store[26] = MICRO_WORD(0, COND_NONE, 25);
+    store[25] = MICRO_WORD(0, COND_R, 25);
+    store[27] = MICRO_WORD(0, COND_NONE, 18);
+    //ST, STR, STI
+    store[3] = MICRO_WORD(0, COND_NONE, 23);
+    store[7] = MICRO_WORD(0, COND_NONE, 23);
+    store[11] = MICRO_WORD(0, COND_NONE, 29);
+    store[29] = MICRO_WORD(0, COND_R, 29);
+    store[31] = MICRO_WORD(0, COND_NONE, 23);
+    store[23] = MICRO_WORD(0, COND_NONE, 16);
+    store[16] = MICRO_WORD(0, COND_R, 16);
+    //JSR, JSRR
+    store[4] = MICRO_WORD(0, COND_IR11, 20);
+    store[20] = MICRO_WORD(0, COND_NONE, 18);
+    store[21] = MICRO_WORD(0, COND_NONE, 18);
+    //TRAP
+    store[15] = MICRO_WORD(0, COND_NONE, 28);
+    store[28] = MICRO_WORD(0, COND_R, 28);
+    store[30] = MICRO_WORD(0, COND_NONE, 18);
+    //RTI, user mode goes to the privilege exception of state 44.
+    store[8] = MICRO_WORD(0, COND_PSR, 36);
+    store[36] = MICRO_WORD(0, COND_R, 36);
+    store[38] = MICRO_WORD(0, COND_NONE, 39);
+    store[39] = MICRO_WORD(0, COND_NONE, 40);
+    store[40] = MICRO_WORD(0, COND_R, 40);
+    store[42] = MICRO_WORD(0, COND_NONE, 34);
+    store[34] = MICRO_WORD(0, COND_PSR, 51);
+    store[51] = MICRO_WORD(0, COND_NONE, 18);
+    store[59] = MICRO_WORD(0, COND_NONE, 18);
+
+    //interrupt, privilege and illegal opcode entry, 45 swaps to the supervisor stack.
+    store[49] = MICRO_WORD(0, COND_PSR, 37);
+    store[44] = MICRO_WORD(0, COND_PSR, 37);
+    store[13] = MICRO_WORD(0, COND_PSR, 37);
+    store[45] = MICRO_WORD(0, COND_NONE, 37);
+    store[37] = MICRO_WORD(0, COND_NONE, 41);
+    store[41] = MICRO_WORD(0, COND_R, 41);
+    store[43] = MICRO_WORD(0, COND_NONE, 47);
+    store[47] = MICRO_WORD(0, COND_NONE, 48);
+    store[48] = MICRO_WORD(0, COND_R, 48);
+    store[50] = MICRO_WORD(0, COND_NONE, 52);
+    store[52] = MICRO_WORD(0, COND_R, 52);
+    store[54] = MICRO_WORD(0, COND_NONE, 18);
+}
+
+struct microcode_lc3_t
+{
+    micro_instruction_t store[0x40];
+
+    microcode_lc3_t()
+    {
+        control_store_load_lc3(store);
+    }
+};
+
+const micro_instruction_t *microcode_lc3()
+{
+    static const microcode_lc3_t lc3;
+    return lc3.store;
+}
+
+/*
+function define:
+    next state of the microsequencer, memory is always ready once waited for,
+    BEN, IR[11] and PSR[15] all read as cond
+*/
+static uint8_t micro_next(micro_instruction_t u, uint8_t opcode, uint8_t cond, uint8_t interrupt)
+{
+    if(MICRO_IRD(u))
+        return opcode;
+
+    uint8_t j = MICRO_J(u);
+    switch(MICRO_COND(u))
+    {
+    case COND_R:
+        return j | 0x02;
+    case COND_BEN:
+        return j | (cond << 2);
+    case COND_IR11:
+        return j | cond;
+    case COND_PSR:
+        return j | (cond << 3);
+    case COND_INT:
+        return j | (interrupt << 4);
+    default:
+        return j;
+    }
+}
+
+//cycles from state 18 back to it, 0 when the path does not return.
+static uint32_t micro_path(const micro_instruction_t *store, uint16_t mem_latency,
+                           uint8_t opcode, uint8_t cond, uint8_t interrupt)
+{
+    uint32_t cycles = 0;
+    uint8_t state = MICRO_FETCH_STATE;
+    for(uint32_t step = 0; step < MICRO_MAX_PATH; ++step)
+    {
+        micro_instruction_t u = store[state];
+        cycles += MICRO_COND(u) == COND_R ? mem_latency : 1;
+        state = micro_next(u, opcode, cond, interrupt) & 0x3F;
+        if(state == MICRO_FETCH_STATE)
+            return cycles;
+    }
+    return 0;
+}
+
+bool microcode_cycle_cost(machine_t *m, const micro_instruction_t *store, uint16_t mem_latency)
+{
+    uint16_t cost[16];
+    uint16_t cost_alt[16];
+    uint16_t interrupt_cost[2];
+
+    //LC-3b dispatches on its own opcode map with other memory states.
+    if(m->isa != ISA_LC3)
+        return false;
+
+    for(uint8_t opcode = 0; opcode < 16; ++opcode)
+    {
+        uint32_t straight = micro_path(store, mem_latency, opcode, 0, 0);
+        uint32_t alt = micro_path(store, mem_latency, opcode, 1, 0);
+        if(!straight || !alt)
+            return false;
+        cost[opcode] = (uint16_t)straight;
+        cost_alt[opcode] = (uint16_t)alt;
+    }
+
+    //the interrupt path leaves state 18 before the fetch, 18 is charged to it.
+    for(uint8_t user = 0; user < 2; ++user)
+    {
+        uint32_t cycles = micro_path(store, mem_latency, 0, user, 1);
+        if(!cycles)
+            return false;
+        interrupt_cost[user] = (uint16_t)cycles;
+    }
+
+    memcpy(m->cycle_cost, cost, sizeof(cost));
+    memcpy(m->cycle_cost_alt, cost_alt, sizeof(cost_alt));
+    memcpy(m->interrupt_cost, interrupt_cost, sizeof(interrupt_cost));
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef MICROCODE_H
+#define MICROCODE_H
+
+#include"../type/type.h"
+#include"../mem/micro_instruction.h"
+#include"machine.h"
+
+//the fetch state, every instruction path starts and ends here.
+#define MICRO_FETCH_STATE 18
+//a path longer than this never returns to the fetch state.
+#define MICRO_MAX_PATH 0x100
+//cycles a state waiting on memory ready takes in the costs machine_init sets.
+#define MICRO_MEM_LATENCY 1
+
+//sequencing of the LC-3 state machine, J, COND and IRD of every state.
+void control_store_load_lc3(micro_instruction_t *store);
+
+//a store loaded by control_store_load_lc3 once, shared read only.
+const micro_instruction_t *microcode_lc3();
+
+/*
+function define:
+    walk store from state 18 through every execute path back to state 18
+    and fill cycle_cost, cycle_cost_alt and interrupt_cost of m
+    a state is one cycle, a state waiting on COND_R is mem_latency cycles
+    return false and leave m untouched when a path never reaches state 18
+    or m is an LC-3b machine, the store only holds the LC-3 sequencing
+    the costs are copied into m once, editing store afterwards changes
+    nothing until microcode_cycle_cost is called again
+*/
+bool microcode_cycle_cost(machine_t *m, const micro_instruction_t *store, uint16_t mem_latency);
+
+#endif //MICROCODE_H
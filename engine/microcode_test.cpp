@@ -0,0 +1,60 @@
+#include<stdio.h>
+#include<vector>
+
+#include"microcode.h"
+#include"../test/check.h"
+
+//ADD R1,R1,#2; LOOP ADD R1,R1,#-1; BRp LOOP; HALT.
+static const uint8_t program[] = {0x30, 0x00, 0x12, 0x62, 0x12, 0x7F, 0x03, 0xFE, 0xF0, 0x25};
+
+int main()
+{
+    micro_instruction_t store[0x40];
+    control_store_load_lc3(store);
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    machine_t *m = new machine_t();
+    machine_init(m, ISA_LC3, mem.data());
+
+    //fetch is 18, 33, 35, 32 with one memory wait.
+    const uint16_t latency = 3;
+    const uint16_t fetch = 3 + latency;
+    CHECK(microcode_cycle_cost(m, store, latency));
+    CHECK(m->cycle_cost[0x1] == fetch + 1 && m->cycle_cost[0x5] == fetch + 1 && m->cycle_cost[0x9] == fetch + 1);
+    //LD waits on memory again in 25.
+    CHECK(m->cycle_cost[0x2] == fetch + 2 + latency);
+    CHECK(m->cycle_cost[0xA] == fetch + 3 + 2 * latency);
+    //a taken BR goes through 22.
+    CHECK(m->cycle_cost[0x0] == fetch + 1 && m->cycle_cost_alt[0x0] == fetch + 2);
+    CHECK(m->cycle_cost[0xF] == fetch + 2 + latency);
+    //18, 49 and the three memory states of the stack and vector, 45 more from user mode.
+    CHECK(m->interrupt_cost[0] == 7 + 3 * latency && m->interrupt_cost[1] == 8 + 3 * latency);
+
+    //the costs are a copy, an edited state counts once recomputed.
+    store[1] = MICRO_WORD(0, COND_NONE, 22);
+    CHECK(m->cycle_cost[0x1] == fetch + 1);
+    CHECK(microcode_cycle_cost(m, store, latency));
+    CHECK(m->cycle_cost[0x1] == fetch + 2 && m->cycle_cost[0x5] == fetch + 1);
+
+    //a path that never gets back to 18 leaves the costs alone.
+    store[5] = MICRO_WORD(0, COND_NONE, 5);
+    CHECK(!microcode_cycle_cost(m, store, latency));
+    CHECK(m->cycle_cost[0x5] == fetch + 1);
+
+    //machine_init charges the shared LC-3 store, taken and not taken BR apart.
+    machine_init(m, ISA_LC3, mem.data());
+    CHECK(m->cycle_cost[0x1] == 4 + MICRO_MEM_LATENCY);
+    machine_load_obj(m, program, sizeof(program));
+    machine_run(m, 100);
+    CHECK(m->state == MACHINE_HALTED && m->instructions == 6);
+    CHECK(m->cycles == (uint64_t)(3 * m->cycle_cost[0x1] + m->cycle_cost_alt[0x0] + m->cycle_cost[0x0] + m->cycle_cost[0xF]));
+    CHECK(m->cycle_cost_alt[0x0] == m->cycle_cost[0x0] + 1);
+
+    //LC-3b dispatches on other states and keeps one cycle per instruction.
+    std::vector<word_t> mem_b(0x8000, 0);
+    machine_init(m, ISA_LC3B, mem_b.data());
+    CHECK(m->cycle_cost[0x1] == 1);
+    CHECK(!microcode_cycle_cost(m, store, latency));
+
+    delete m;
+    return check_result();
+}
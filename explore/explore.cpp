@@ -0,0 +1,304 @@
+#include<string.h>
+
+#include"explore.h"
+#include"../probe/probe.h"
+
+//a machine stopped at a keyboard read, waiting to run with one more input byte.
+struct explore_node_t
+{
+    machine_t machine;
+    snapshot_id_t snapshot;
+    std::vector<uint8_t> input;
+    //new edges of the path that forked it.
+    uint32_t score;
+};
+
+//per thread state of one worker.
+struct explore_worker_t
+{
+    explore_t *explore;
+    machine_t machine;
+    word_t *work;
+    uint8_t seen[COVERAGE_BYTES];
+    word_t last_pc;
+    bool first;
+
+    //machine state before the refused instruction.
+    word_t pc;
+    word_t psr;
+    word_t saved_ssp;
+    word_t saved_usp;
+    reg_t reg[0x8];
+};
+
+static const uint8_t explore_classes[] =
+{
+    '0', '5', '9',
+    'a', 'z', 'A', 'Z',
+    '\n', ' ', '-',
+    0x00, 0x7F, 0xFF
+};
+
+static void explore_trace(machine_t *m, word_t pc, word_t ir, void *ctx)
+{
+    (void)m;
+    (void)ir;
+    explore_worker_t *w = (explore_worker_t *)ctx;
+    if(!w->first)
+    {
+        uint32_t edge = COVERAGE_EDGE(w->last_pc, pc);
+        w->seen[edge >> 3] |= (uint8_t)(1 << (edge & 7));
+    }
+    w->first = false;
+    w->last_pc = pc;
+}
+
+//fork once the input read so far is used up.
+static bool explore_on_input(machine_t *m, input_kind_t kind, void *ctx)
+{
+    explore_worker_t *w = (explore_worker_t *)ctx;
+    if(m->input_pos < m->input_len || m->input_len >= w->explore->max_input_len)
+        return true;
+
+    //the observing instruction has only fetched so far, keep what it may still change.
+    word_t step = m->isa == ISA_LC3B ? lc3b_isa_t::pc_step : lc3_isa_t::pc_step;
+    w->pc = kind == INPUT_INTERRUPT ? m->pc : m->pc - step;
+    w->psr = m->psr;
+    w->saved_ssp = m->saved_ssp;
+    w->saved_usp = m->saved_usp;
+    memcpy(w->reg, m->reg, sizeof(w->reg));
+    return false;
+}
+
+//takes the store lock, never call it with explore->lock held.
+static void node_release(explore_t *explore, explore_node_t *node)
+{
+    pthread_rwlock_wrlock(&explore->store_lock);
+    snapshot_release(&explore->store, node->snapshot);
+    pthread_rwlock_unlock(&explore->store_lock);
+    delete node;
+}
+
+//under lock, a full frontier drops its lowest scoring node, returned for the caller to release.
+static explore_node_t *frontier_push(explore_t *explore, explore_node_t *node)
+{
+    explore->frontier.insert({node->score, node});
+    if(explore->frontier.size() <= explore->max_frontier)
+        return 0;
+    auto worst = explore->frontier.begin();
+    explore_node_t *dropped = worst->second;
+    explore->frontier.erase(worst);
+    ++explore->dropped;
+    return dropped;
+}
+
+//snapshot the stopped machine in w->work, only the pages it changed since node are stored again.
+static snapshot_id_t worker_fork(explore_worker_t *w, const explore_node_t *node, uint32_t children)
+{
+    explore_t *explore = w->explore;
+    uint8_t dirty[PAGE_COUNT];
+    pthread_rwlock_rdlock(&explore->store_lock);
+    snapshot_diff(&explore->store, node->snapshot, w->work, dirty);
+    pthread_rwlock_unlock(&explore->store_lock);
+
+    pthread_rwlock_wrlock(&explore->store_lock);
+    snapshot_id_t fork = snapshot_take_dirty(&explore->store, node->snapshot, w->work, dirty);
+    //one holder per child, the take's own is handed to the first.
+    for(uint32_t i = 1; i < children; ++i)
+        snapshot_retain(&explore->store, fork);
+    pthread_rwlock_unlock(&explore->store_lock);
+    return fork;
+}
+
+static void worker_run_node(explore_worker_t *w, explore_node_t *node)
+{
+    explore_t *explore = w->explore;
+    machine_t *m = &w->machine;
+
+    pthread_rwlock_rdlock(&explore->store_lock);
+    snapshot_restore(&explore->store, node->snapshot, w->work);
+    pthread_rwlock_unlock(&explore->store_lock);
+
+    *m = node->machine;
+    m->mem = w->work;
+    m->decode = 0;
+    m->input = node->input.data();
+    m->input_len = (uint32_t)node->input.size();
+    m->on_input = explore_on_input;
+    m->input_ctx = w;
+    m->trace = explore_trace;
+    m->trace_ctx = w;
+    memset(w->seen, 0, sizeof(w->seen));
+    w->first = true;
+    uint64_t budget = explore->max_instructions > m->instructions ? explore->max_instructions - m->instructions : 0;
+    machine_run(m, budget);
+
+    pthread_mutex_lock(&explore->lock);
+    ++explore->paths;
+    uint32_t new_edges = 0;
+    for(uint32_t i = 0; i < COVERAGE_BYTES; ++i)
+    {
+        uint8_t fresh = w->seen[i] & ~explore->coverage[i];
+        if(fresh)
+        {
+            new_edges += __builtin_popcount(fresh);
+            explore->coverage[i] |= fresh;
+        }
+    }
+    explore->edges += new_edges;
+
+    //the root always counts, it is the empty input.
+    bool fork = false;
+    if(new_edges || node->input.empty())
+    {
+        explore_result_t result;
+        result.input = node->input;
+        result.new_edges = new_edges;
+        result.state = m->state;
+        result.instructions = m->instructions;
+        explore->results.push_back(result);
+        fork = m->state == MACHINE_INPUT && explore->paths < explore->max_paths && !explore->candidates.empty();
+    }
+    pthread_mutex_unlock(&explore->lock);
+
+    if(fork)
+    {
+        m->pc = w->pc;
+        m->psr = w->psr;
+        m->saved_ssp = w->saved_ssp;
+        m->saved_usp = w->saved_usp;
+        memcpy(m->reg, w->reg, sizeof(m->reg));
+        m->state = MACHINE_RUNNING;
+        m->on_input = 0;
+        m->input_ctx = 0;
+        m->trace = 0;
+        m->trace_ctx = 0;
+
+        //children share the fork through the content addressed store.
+        uint32_t children = (uint32_t)explore->candidates.size();
+        snapshot_id_t snapshot = worker_fork(w, node, children);
+        std::vector<explore_node_t *> dropped;
+        std::vector<explore_node_t *> made;
+        for(uint8_t c : explore->candidates)
+        {
+            explore_node_t *child = new explore_node_t();
+            child->machine = *m;
+            child->snapshot = snapshot;
+            child->input = node->input;
+            child->input.push_back(c);
+            child->score = new_edges;
+            made.push_back(child);
+        }
+
+        pthread_mutex_lock(&explore->lock);
+        for(explore_node_t *child : made)
+        {
+            explore_node_t *worst = frontier_push(explore, child);
+            if(worst)
+                dropped.push_back(worst);
+        }
+        pthread_mutex_unlock(&explore->lock);
+        for(explore_node_t *worst : dropped)
+            node_release(explore, worst);
+    }
+    node_release(explore, node);
+}
+
+static void *explore_worker(void *ctx)
+{
+    explore_worker_t *w = (explore_worker_t *)ctx;
+    explore_t *explore = w->explore;
+    for(;;)
+    {
+        pthread_mutex_lock(&explore->lock);
+        while(explore->frontier.empty() && explore->busy)
+            pthread_cond_wait(&explore->wake, &explore->lock);
+        if(explore->frontier.empty() || explore->paths >= explore->max_paths)
+        {
+            //nothing queued and nobody left to queue more, or out of paths.
+            pthread_cond_broadcast(&explore->wake);
+            pthread_mutex_unlock(&explore->lock);
+            return 0;
+        }
+        auto best = --explore->frontier.end();
+        explore_node_t *node = best->second;
+        explore->frontier.erase(best);
+        ++explore->busy;
+        //paths run or running, the id of this one.
+        uint32_t path = explore->paths + explore->busy - 1;
+        pthread_mutex_unlock(&explore->lock);
+
+        PROBE2(job_start, path, (uint32_t)node->input.size());
+        worker_run_node(w, node);
+
+        pthread_mutex_lock(&explore->lock);
+        --explore->busy;
+        pthread_cond_broadcast(&explore->wake);
+        pthread_mutex_unlock(&explore->lock);
+    }
+}
+
+void explore_init(explore_t *explore, const machine_t *init, uint64_t max_instructions)
+{
+    explore->init = init;
+    explore->candidates.assign(explore_classes, explore_classes + sizeof(explore_classes));
+    explore->max_instructions = max_instructions;
+    explore->max_input_len = 16;
+    explore->max_frontier = 4096;
+    explore->max_paths = 100000;
+    explore->threads = 1;
+
+    pthread_mutex_init(&explore->lock, 0);
+    pthread_cond_init(&explore->wake, 0);
+    pthread_rwlock_init(&explore->store_lock, 0);
+    explore->frontier.clear();
+    explore->busy = 0;
+    memset(explore->coverage, 0, sizeof(explore->coverage));
+    explore->results.clear();
+    explore->edges = 0;
+    explore->paths = 0;
+    explore->dropped = 0;
+}
+
+void explore_run(explore_t *explore)
+{
+    uint32_t mem_words = explore->init->isa == ISA_LC3B ? lc3b_isa_t::mem_words : lc3_isa_t::mem_words;
+    uint32_t threads = explore->threads ? explore->threads : 1;
+
+    //snapshots always span MEM_WORDS.
+    word_t *work = new word_t[MEM_WORDS]();
+    memcpy(work, explore->init->mem, mem_words * sizeof(word_t));
+    explore_node_t *root = new explore_node_t();
+    root->machine = *explore->init;
+    root->snapshot = snapshot_take(&explore->store, work);
+    root->score = 0;
+    explore->frontier.insert({0, root});
+    delete[] work;
+
+    std::vector<explore_worker_t *> workers;
+    std::vector<pthread_t> ids(threads);
+    for(uint32_t i = 0; i < threads; ++i)
+    {
+        explore_worker_t *w = new explore_worker_t();
+        w->explore = explore;
+        w->work = new word_t[MEM_WORDS]();
+        workers.push_back(w);
+        pthread_create(&ids[i], 0, explore_worker, w);
+    }
+    for(uint32_t i = 0; i < threads; ++i)
+    {
+        pthread_join(ids[i], 0);
+        delete[] workers[i]->work;
+        delete workers[i];
+    }
+}
+
+void explore_destroy(explore_t *explore)
+{
+    for(auto &entry : explore->frontier)
+        node_release(explore, entry.second);
+    explore->frontier.clear();
+    pthread_rwlock_destroy(&explore->store_lock);
+    pthread_cond_destroy(&explore->wake);
+    pthread_mutex_destroy(&explore->lock);
+}
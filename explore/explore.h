@@ -0,0 +1,73 @@
+#ifndef EXPLORE_H
+#define EXPLORE_H
+
+#include<pthread.h>
+#include<vector>
+#include<map>
+
+#include"../type/type.h"
+#include"../engine/machine.h"
+#include"../snapshot/page_store.h"
+
+//edge coverage map, one bit per hashed (previous PC, PC) pair.
+#define COVERAGE_BITS 0x10000
+#define COVERAGE_BYTES (COVERAGE_BITS / 8)
+#define COVERAGE_EDGE(from, to) (uint32_t)((((from) * 0x9E3779B1u) ^ (to)) & (COVERAGE_BITS - 1))
+
+//an input that reached edges no earlier input reached.
+struct explore_result_t
+{
+    std::vector<uint8_t> input;
+    uint32_t new_edges;
+    machine_state_t state;
+    uint64_t instructions;
+};
+
+struct explore_node_t;
+
+struct explore_t
+{
+    //every path starts from this machine, its mem is left untouched.
+    const machine_t *init;
+    //bytes tried at each keyboard read: digits, letters, newline and boundary values.
+    std::vector<uint8_t> candidates;
+    uint64_t max_instructions;
+    uint32_t max_input_len;
+    //nodes waiting to run, the ones with the fewest new edges are dropped past it.
+    uint32_t max_frontier;
+    uint32_t max_paths;
+    uint32_t threads;
+
+    //shared by the workers under lock.
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    std::multimap<uint32_t, explore_node_t *> frontier;
+    uint32_t busy;
+    uint8_t coverage[COVERAGE_BYTES];
+
+    //restores and diffs share store_lock, takes and releases hold it alone,
+    //it is never waited for while lock is held.
+    pthread_rwlock_t store_lock;
+    page_store_t store;
+
+    std::vector<explore_result_t> results;
+    uint32_t edges;
+    uint32_t paths;
+    uint32_t dropped;
+};
+
+void explore_init(explore_t *explore, const machine_t *init, uint64_t max_instructions);
+
+/*
+function define:
+    run init until it reads a keyboard byte or KBSR with no input left, there
+    fork it through a snapshot, one child per candidate byte appended to the
+    input read so far, children that reach new coverage edges are kept as
+    results and forked again at their next read
+    children run on explore->threads workers, best first from a bounded frontier
+*/
+void explore_run(explore_t *explore);
+
+void explore_destroy(explore_t *explore);
+
+#endif //EXPLORE_H
@@ -0,0 +1,70 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"explore.h"
+#include"../test/check.h"
+
+//twice GETC; ADD R0,R0,#0; BRz +1; ADD R2,R2,#1, then HALT.
+static const uint8_t program[] =
+{
+    0x30, 0x00,
+    0xF0, 0x20, 0x10, 0x20, 0x04, 0x01, 0x14, 0xA1,
+    0xF0, 0x20, 0x10, 0x20, 0x04, 0x01, 0x14, 0xA1, 0xF0, 0x25
+};
+
+struct outcome_t
+{
+    uint32_t edges;
+    uint32_t paths;
+    uint32_t results;
+    uint32_t halted;
+    uint32_t pages;
+};
+
+static outcome_t run(const machine_t *init, uint32_t threads)
+{
+    explore_t *explore = new explore_t();
+    explore_init(explore, init, 10000);
+    explore->threads = threads;
+    explore_run(explore);
+
+    outcome_t out;
+    out.edges = explore->edges;
+    out.paths = explore->paths;
+    out.results = (uint32_t)explore->results.size();
+    out.halted = 0;
+    for(const explore_result_t &result : explore->results)
+        if(result.state == MACHINE_HALTED)
+            ++out.halted;
+    explore_destroy(explore);
+    //every node gave its snapshot back.
+    out.pages = page_store_unique_pages(&explore->store);
+    delete explore;
+    return out;
+}
+
+int main()
+{
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    machine_t *init = new machine_t();
+    machine_init(init, ISA_LC3, mem.data());
+    machine_load_obj(init, program, sizeof(program));
+
+    outcome_t one = run(init, 1);
+    outcome_t three = run(init, 3);
+
+    //the root, then zero and non zero bytes at each read.
+    CHECK(one.results >= 3 && one.halted >= 2);
+    CHECK(one.pages == 0 && three.pages == 0);
+    //twins reach the same edges, whichever thread runs one first keeps them.
+    CHECK(one.edges == three.edges);
+    CHECK(one.paths == three.paths);
+    CHECK(one.results == three.results);
+    CHECK(one.halted == three.halted);
+    //the image is left alone.
+    CHECK(mem[0x3000] == 0xF020 && init->reg[2] == 0);
+
+    delete init;
+    return check_result();
+}
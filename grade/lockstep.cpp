@@ -0,0 +1,339 @@
+#include<stdio.h>
+#include<string.h>
+#include<unordered_map>
+
+#include"lockstep.h"
+#include"../engine/engine.h"
+
+struct lockstep_side_t
+{
+    machine_t *m;
+    const grade_observe_t *observe;
+    std::deque<grade_event_t> events;
+
+    uint8_t watch[WATCH_BYTES];
+    uint8_t pc_check[WATCH_BYTES];
+    std::unordered_map<word_t, std::vector<uint16_t> > points_at;
+
+    uint32_t output_pos;
+    uint64_t limit;
+    //instruction count at which the check points of the PC were reported.
+    uint64_t checked_instruction;
+    word_t step_pc;
+    bool ended;
+    bool limited;
+};
+
+static grade_event_t event_make(lockstep_side_t *side, grade_event_kind_t kind)
+{
+    grade_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.kind = kind;
+    event.instruction = side->m->instructions;
+    event.pc = side->step_pc;
+    return event;
+}
+
+static void on_watched_write(machine_t *m, word_t addr, word_t value, void *ctx)
+{
+    (void)m;
+    lockstep_side_t *side = (lockstep_side_t *)ctx;
+    grade_event_t event = event_make(side, EVENT_WRITE);
+    event.addr = addr;
+    event.value = value;
+    side->events.push_back(event);
+}
+
+static void side_init(lockstep_side_t *side, machine_t *m, const grade_observe_t *observe,
+                      bool is_ref, uint64_t max_instructions)
+{
+    side->m = m;
+    side->observe = observe;
+    side->output_pos = (uint32_t)m->output.size();
+    side->limit = m->instructions + max_instructions;
+    side->checked_instruction = UINT64_MAX;
+    side->step_pc = m->pc;
+    side->ended = false;
+    side->limited = false;
+
+    memset(side->watch, 0, sizeof(side->watch));
+    for(word_t addr : observe->write_addrs)
+        side->watch[addr >> 3] |= 1 << (addr & 7);
+
+    memset(side->pc_check, 0, sizeof(side->pc_check));
+    for(uint16_t i = 0; i < observe->points.size(); ++i)
+    {
+        word_t pc = is_ref ? observe->points[i].ref_pc : observe->points[i].sub_pc;
+        side->pc_check[pc >> 3] |= 1 << (pc & 7);
+        side->points_at[pc].push_back(i);
+    }
+
+    if(!observe->write_addrs.empty())
+    {
+        m->write_watch = side->watch;
+        m->on_write = on_watched_write;
+        m->write_ctx = side;
+    }
+}
+
+static void side_detach(lockstep_side_t *side)
+{
+    if(side->m->write_ctx == side)
+    {
+        side->m->write_watch = 0;
+        side->m->on_write = 0;
+        side->m->write_ctx = 0;
+    }
+}
+
+//step one side until it has an event queued or it stops.
+template<typename isa_t>
+static void side_advance(lockstep_side_t *side)
+{
+    machine_t *m = side->m;
+    while(side->events.empty() && !side->ended)
+    {
+        if(m->state != MACHINE_RUNNING || m->instructions >= side->limit)
+        {
+            side->limited = m->state == MACHINE_RUNNING;
+            side->step_pc = m->pc;
+            grade_event_t event = event_make(side, EVENT_END);
+            event.value = (word_t)m->state;
+            side->events.push_back(event);
+            side->ended = true;
+            break;
+        }
+
+        if(m->instructions >= m->next_event)
+        {
+            engine_poll<isa_t>(m);
+            continue;
+        }
+
+        //registers are observed on arrival, before the instruction at the PC runs.
+        if(side->checked_instruction != m->instructions && WATCHED(side->pc_check, m->pc))
+        {
+            side->checked_instruction = m->instructions;
+            side->step_pc = m->pc;
+            for(uint16_t i : side->points_at[m->pc])
+            {
+                grade_event_t event = event_make(side, EVENT_REGS);
+                event.point = i;
+                event.reg_mask = side->observe->points[i].reg_mask;
+                for(int r = 0; r < 8; ++r)
+                {
+                    if(event.reg_mask & (1 << r))
+                        event.reg[r] = m->reg[r];
+                }
+                side->events.push_back(event);
+            }
+            continue;
+        }
+
+        side->step_pc = m->pc;
+        engine_step<isa_t>(m);
+
+        if(side->observe->output)
+        {
+            for(; side->output_pos < m->output.size(); ++side->output_pos)
+            {
+                grade_event_t event = event_make(side, EVENT_OUTPUT);
+                event.value = m->output[side->output_pos];
+                side->events.push_back(event);
+            }
+        }
+    }
+}
+
+static bool event_equal(const grade_event_t &a, const grade_event_t &b)
+{
+    if(a.kind != b.kind)
+        return false;
+    switch(a.kind)
+    {
+    case EVENT_WRITE:
+        return a.addr == b.addr && a.value == b.value;
+    case EVENT_REGS:
+        if(a.point != b.point)
+            return false;
+        for(int r = 0; r < 8; ++r)
+        {
+            if((a.reg_mask & (1 << r)) && a.reg[r] != b.reg[r])
+                return false;
+        }
+        return true;
+    default:
+        return a.value == b.value;
+    }
+}
+
+template<typename isa_t>
+static void lockstep_loop(lockstep_side_t *ref, lockstep_side_t *sub, lockstep_result_t *result)
+{
+    for(;;)
+    {
+        side_advance<isa_t>(ref);
+        side_advance<isa_t>(sub);
+        if(ref->events.empty() || sub->events.empty())
+            return;
+
+        const grade_event_t &a = ref->events.front();
+        const grade_event_t &b = sub->events.front();
+        if(a.kind == EVENT_END && b.kind == EVENT_END && (ref->limited || sub->limited))
+        {
+            result->status = LOCKSTEP_LIMIT;
+            result->expected = a;
+            result->actual = b;
+            return;
+        }
+        if(!event_equal(a, b))
+        {
+            result->status = (b.kind == EVENT_END && sub->limited) || (a.kind == EVENT_END && ref->limited)
+                           ? LOCKSTEP_LIMIT : LOCKSTEP_DIVERGED;
+            result->expected = a;
+            result->actual = b;
+            return;
+        }
+        ref->events.pop_front();
+        sub->events.pop_front();
+        ++result->events_matched;
+    }
+}
+
+uint32_t grade_parse_symbols(const char *text, std::vector<grade_symbol_t> *symbols)
+{
+    uint32_t count = 0;
+    while(*text)
+    {
+        const char *end = strchr(text, '\n');
+        if(!end)
+            end = text + strlen(text);
+
+        //headers and rules fail the hex address or leave text behind.
+        char line[128];
+        uint32_t n = (uint32_t)(end - text) < sizeof(line) - 1 ? (uint32_t)(end - text) : sizeof(line) - 1;
+        memcpy(line, text, n);
+        line[n] = 0;
+        grade_symbol_t symbol;
+        char address[8];
+        unsigned int addr;
+        int used = 0;
+        if(sscanf(line, "//%31s %7s %n", symbol.name, address, &used) == 2 && !line[used]
+           && sscanf(address, "%x%n", &addr, &used) == 1 && !address[used] && addr <= 0xFFFF)
+        {
+            symbol.addr = (word_t)addr;
+            symbols->push_back(symbol);
+            ++count;
+        }
+        text = *end ? end + 1 : end;
+    }
+    return count;
+}
+
+static bool symbol_find(const std::vector<grade_symbol_t> &symbols, const char *name, word_t *addr)
+{
+    for(const grade_symbol_t &symbol : symbols)
+    {
+        if(!strcmp(symbol.name, name))
+        {
+            *addr = symbol.addr;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool grade_point_label(grade_observe_t *observe, const std::vector<grade_symbol_t> &ref_symbols,
+                       const std::vector<grade_symbol_t> &sub_symbols, const char *label, uint8_t reg_mask)
+{
+    grade_point_t point;
+    memset(&point, 0, sizeof(point));
+    if(strlen(label) >= GRADE_LABEL_LEN
+       || !symbol_find(ref_symbols, label, &point.ref_pc) || !symbol_find(sub_symbols, label, &point.sub_pc))
+        return false;
+    point.reg_mask = reg_mask;
+    strcpy(point.label, label);
+    observe->points.push_back(point);
+    return true;
+}
+
+void lockstep_run(machine_t *ref, machine_t *sub, const grade_observe_t *observe,
+                  const uint8_t *input, uint32_t input_len,
+                  uint64_t max_instructions, lockstep_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    result->status = LOCKSTEP_MATCH;
+    //the loop steps both sides with the traits of one variant.
+    if(ref->isa != sub->isa)
+    {
+        result->status = LOCKSTEP_ISA_MISMATCH;
+        return;
+    }
+
+    machine_set_input(ref, input, input_len);
+    machine_set_input(sub, input, input_len);
+
+    lockstep_side_t *ref_side = new lockstep_side_t();
+    lockstep_side_t *sub_side = new lockstep_side_t();
+    side_init(ref_side, ref, observe, true, max_instructions);
+    side_init(sub_side, sub, observe, false, max_instructions);
+
+    if(ref->isa == ISA_LC3B)
+        lockstep_loop<lc3b_isa_t>(ref_side, sub_side, result);
+    else
+        lockstep_loop<lc3_isa_t>(ref_side, sub_side, result);
+
+    side_detach(ref_side);
+    side_detach(sub_side);
+    delete ref_side;
+    delete sub_side;
+}
+
+static int event_describe(const grade_event_t *event, const grade_observe_t *observe, char *buf, uint32_t len)
+{
+    switch(event->kind)
+    {
+    case EVENT_OUTPUT:
+        return snprintf(buf, len, "output x%02X at x%04X", event->value, event->pc);
+    case EVENT_WRITE:
+        return snprintf(buf, len, "M[x%04X] <- x%04X at x%04X", event->addr, event->value, event->pc);
+    case EVENT_REGS:
+    {
+        const char *label = event->point < observe->points.size() ? observe->points[event->point].label : "";
+        int n = label[0] ? snprintf(buf, len, "%s at x%04X:", label, event->pc)
+                         : snprintf(buf, len, "check point %u at x%04X:", event->point, event->pc);
+        for(int r = 0; r < 8 && n >= 0 && (uint32_t)n < len; ++r)
+        {
+            if(event->reg_mask & (1 << r))
+                n += snprintf(buf + n, len - n, " R%d=x%04X", r, event->reg[r]);
+        }
+        return n;
+    }
+    default:
+        return snprintf(buf, len, "end in state %u at x%04X", event->value, event->pc);
+    }
+}
+
+void lockstep_describe(const lockstep_result_t *result, const grade_observe_t *observe, char *buf, uint32_t len)
+{
+    if(result->status == LOCKSTEP_MATCH)
+    {
+        snprintf(buf, len, "match, %llu events", (unsigned long long)result->events_matched);
+        return;
+    }
+    if(result->status == LOCKSTEP_ISA_MISMATCH)
+    {
+        snprintf(buf, len, "reference and submission are built for different variants");
+        return;
+    }
+
+    char expected[128];
+    char actual[128];
+    event_describe(&result->expected, observe, expected, sizeof(expected));
+    event_describe(&result->actual, observe, actual, sizeof(actual));
+    snprintf(buf, len, "%s after %llu events: expected %s (instruction %llu), got %s (instruction %llu)",
+             result->status == LOCKSTEP_LIMIT ? "instruction limit" : "diverged",
+             (unsigned long long)result->events_matched,
+             expected, (unsigned long long)result->expected.instruction,
+             actual, (unsigned long long)result->actual.instruction);
+}
@@ -0,0 +1,106 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include<vector>
+#include<deque>
+
+#include"../type/type.h"
+#include"../engine/machine.h"
+
+enum grade_event_kind_t
+{
+    EVENT_OUTPUT,
+    EVENT_WRITE,
+    EVENT_REGS,
+    //the machine stopped, value holds its machine_state_t.
+    EVENT_END
+};
+
+struct grade_event_t
+{
+    grade_event_kind_t kind;
+    word_t addr;
+    word_t value;
+    //EVENT_REGS, index of the check point and the compared registers.
+    uint16_t point;
+    uint8_t reg_mask;
+    reg_t reg[0x8];
+    //instruction count and PC of the side that produced the event.
+    uint64_t instruction;
+    word_t pc;
+};
+
+#define GRADE_LABEL_LEN 32
+
+//registers in reg_mask are compared each time the reference reaches ref_pc
+//and the submission reaches sub_pc, the k-th arrivals are paired.
+struct grade_point_t
+{
+    word_t ref_pc;
+    word_t sub_pc;
+    uint8_t reg_mask;
+    //the label both PCs came from, empty for a point given by PCs.
+    char label[GRADE_LABEL_LEN];
+};
+
+//one line of an lc3as symbol table.
+struct grade_symbol_t
+{
+    char name[GRADE_LABEL_LEN];
+    word_t addr;
+};
+
+//the observable set.
+struct grade_observe_t
+{
+    bool output;
+    std::vector<word_t> write_addrs;
+    std::vector<grade_point_t> points;
+};
+
+enum lockstep_status_t
+{
+    LOCKSTEP_MATCH,
+    LOCKSTEP_DIVERGED,
+    //one side ran out of its instruction budget.
+    LOCKSTEP_LIMIT,
+    //ref and sub are different variants, nothing was run.
+    LOCKSTEP_ISA_MISMATCH
+};
+
+struct lockstep_result_t
+{
+    lockstep_status_t status;
+    uint64_t events_matched;
+    //the first differing pair, valid when status is LOCKSTEP_DIVERGED.
+    grade_event_t expected;
+    grade_event_t actual;
+};
+
+//read the "//	NAME ADDR" lines of a .sym file, return the symbols added.
+uint32_t grade_parse_symbols(const char *text, std::vector<grade_symbol_t> *symbols);
+
+/*
+function define:
+    add a check point at label, looked up in the symbol table of each side
+    so the programs may place it at different PCs
+    return false if either table lacks the label
+*/
+bool grade_point_label(grade_observe_t *observe, const std::vector<grade_symbol_t> &ref_symbols,
+                       const std::vector<grade_symbol_t> &sub_symbols, const char *label, uint8_t reg_mask);
+
+/*
+function define:
+    run ref and sub side by side on the same input, each side advances
+    to its next observable event, the pair is compared and dropped
+    stop at the first divergence, no trace is kept
+    both machines must be the same variant
+*/
+void lockstep_run(machine_t *ref, machine_t *sub, const grade_observe_t *observe,
+                  const uint8_t *input, uint32_t input_len,
+                  uint64_t max_instructions, lockstep_result_t *result);
+
+//one line of feedback for a result, check points are named by label when they have one.
+void lockstep_describe(const lockstep_result_t *result, const grade_observe_t *observe, char *buf, uint32_t len);
+
+#endif //LOCKSTEP_H
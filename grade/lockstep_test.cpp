@@ -0,0 +1,67 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"lockstep.h"
+#include"../test/check.h"
+
+//R0 = 3, then DONE: HALT.
+static const uint8_t ref_obj[] = {0x30, 0x00, 0x50, 0x20, 0x10, 0x23, 0xF0, 0x25};
+static const char *ref_sym =
+    "// Symbol table\n"
+    "// Scope level 0:\n"
+    "//\tSymbol Name       Page Address\n"
+    "//\t----------------  ------------\n"
+    "//\tDONE              3002\n";
+
+//R0 = 2 + 2 or 1 + 2 in two steps, DONE one word later.
+static const uint8_t bad_obj[] = {0x30, 0x00, 0x50, 0x20, 0x10, 0x22, 0x10, 0x22, 0xF0, 0x25};
+static const uint8_t good_obj[] = {0x30, 0x00, 0x50, 0x20, 0x10, 0x21, 0x10, 0x22, 0xF0, 0x25};
+static const char *sub_sym = "//\tDONE              3003\n";
+
+static lockstep_status_t run(const uint8_t *obj, uint32_t len, const grade_observe_t *observe, char *feedback,
+                             isa_variant_t sub_isa = ISA_LC3)
+{
+    std::vector<word_t> ref_mem(UINT16_MAX, 0);
+    std::vector<word_t> sub_mem(UINT16_MAX, 0);
+    machine_t *ref = new machine_t();
+    machine_t *sub = new machine_t();
+    machine_init(ref, ISA_LC3, ref_mem.data());
+    machine_init(sub, sub_isa, sub_mem.data());
+    machine_load_obj(ref, ref_obj, sizeof(ref_obj));
+    machine_load_obj(sub, obj, len);
+
+    lockstep_result_t result;
+    lockstep_run(ref, sub, observe, 0, 0, 1000, &result);
+    lockstep_describe(&result, observe, feedback, 256);
+    delete ref;
+    delete sub;
+    return result.status;
+}
+
+int main()
+{
+    std::vector<grade_symbol_t> ref_symbols;
+    std::vector<grade_symbol_t> sub_symbols;
+    CHECK(grade_parse_symbols(ref_sym, &ref_symbols) == 1);
+    CHECK(grade_parse_symbols(sub_sym, &sub_symbols) == 1);
+    CHECK(!strcmp(ref_symbols[0].name, "DONE") && ref_symbols[0].addr == 0x3002);
+
+    grade_observe_t observe;
+    observe.output = false;
+    CHECK(!grade_point_label(&observe, ref_symbols, sub_symbols, "LOOP", 0x01));
+    CHECK(grade_point_label(&observe, ref_symbols, sub_symbols, "DONE", 0x01));
+    CHECK(observe.points.size() == 1 && observe.points[0].sub_pc == 0x3003);
+
+    char feedback[256];
+    CHECK(run(good_obj, sizeof(good_obj), &observe, feedback) == LOCKSTEP_MATCH);
+    CHECK(run(bad_obj, sizeof(bad_obj), &observe, feedback) == LOCKSTEP_DIVERGED);
+    CHECK(strstr(feedback, "expected DONE at x3002: R0=x0003") != 0);
+    CHECK(strstr(feedback, "got DONE at x3003: R0=x0004") != 0);
+
+    //an LC-3b submission is refused, not stepped as LC-3.
+    CHECK(run(good_obj, sizeof(good_obj), &observe, feedback, ISA_LC3B) == LOCKSTEP_ISA_MISMATCH);
+    CHECK(strstr(feedback, "different variants") != 0);
+
+    return check_result();
+}
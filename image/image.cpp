@@ -0,0 +1,483 @@
+#include<stdio.h>
+#include<string.h>
+#include<map>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#include"image.h"
+#include"../engine/engine.h"
+#include"../engine/decode_cache.h"
+#include"../profile/span.h"
+
+static uint32_t align8(uint32_t offset)
+{
+    return (offset + 7) & ~7u;
+}
+
+//a table of count entries of size bytes lies inside the image and is aligned.
+static bool table_valid(const image_t *image, uint64_t offset, uint64_t count, uint64_t size)
+{
+    return offset % 8 == 0 && offset + count * size <= image->size;
+}
+
+bool image_view(image_t *image, const uint8_t *data, uint64_t size)
+{
+    image->base = data;
+    image->size = size;
+    image->mapped = false;
+
+    const image_header_t *h = (const image_header_t *)data;
+    if(size < sizeof(image_header_t) || ((uint64_t)data & 7) ||
+       h->magic != IMAGE_MAGIC || h->version != IMAGE_VERSION)
+        return false;
+
+    if(!table_valid(image, h->segment_offset, h->segment_count, sizeof(image_segment_t)) ||
+       !table_valid(image, h->symbol_offset, h->symbol_count, sizeof(image_symbol_t)) ||
+       !table_valid(image, h->block_offset, h->block_count, sizeof(image_block_t)) ||
+       !table_valid(image, h->edge_offset, h->edge_count, sizeof(image_edge_t)) ||
+       (uint64_t)h->string_offset + h->string_size > size)
+        return false;
+
+    image->header = h;
+    image->segments = (const image_segment_t *)(data + h->segment_offset);
+    image->symbols = (const image_symbol_t *)(data + h->symbol_offset);
+    image->blocks = (const image_block_t *)(data + h->block_offset);
+    image->edges = (const image_edge_t *)(data + h->edge_offset);
+    image->strings = (const char *)(data + h->string_offset);
+
+    //bounds only, every index is checked once here and trusted afterwards.
+    if(h->string_size && image->strings[h->string_size - 1])
+        return false;
+    for(uint32_t i = 0; i < h->segment_count; ++i)
+    {
+        if(!table_valid(image, image->segments[i].data_offset, image->segments[i].words, sizeof(word_t)))
+            return false;
+    }
+    for(uint32_t i = 0; i < h->symbol_count; ++i)
+    {
+        if(image->symbols[i].name_offset >= h->string_size)
+            return false;
+    }
+    for(uint32_t i = 0; i < h->block_count; ++i)
+    {
+        const image_block_t &block = image->blocks[i];
+        if((uint64_t)block.first_edge + block.edge_count > h->edge_count ||
+           (block.symbol != INVALID_INDEX && block.symbol >= h->symbol_count))
+            return false;
+    }
+    for(uint32_t i = 0; i < h->edge_count; ++i)
+    {
+        if(image->edges[i].block != INVALID_INDEX && image->edges[i].block >= h->block_count)
+            return false;
+    }
+    return true;
+}
+
+bool image_open(image_t *image, const char *path)
+{
+    SPAN_BEGIN(begin);
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+
+    if(!image_view(image, (const uint8_t *)data, (uint64_t)st.st_size))
+    {
+        munmap(data, (size_t)st.st_size);
+        return false;
+    }
+    image->mapped = true;
+    SPAN_END(begin, SPAN_IMAGE_LOAD, (uint32_t)st.st_size);
+    return true;
+}
+
+void image_close(image_t *image)
+{
+    if(image->mapped)
+        munmap((void *)image->base, (size_t)image->size);
+    image->base = 0;
+    image->size = 0;
+    image->mapped = false;
+}
+
+const image_symbol_t *image_symbol_at(const image_t *image, word_t addr)
+{
+    uint32_t lo = 0;
+    uint32_t hi = image->header->symbol_count;
+    while(lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if(image->symbols[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo ? &image->symbols[lo - 1] : 0;
+}
+
+const image_block_t *image_block_at(const image_t *image, word_t addr)
+{
+    uint32_t lo = 0;
+    uint32_t hi = image->header->block_count;
+    while(lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if(image->blocks[mid].start <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(!lo)
+        return 0;
+
+    const image_block_t *block = &image->blocks[lo - 1];
+    uint32_t step = image->header->isa == ISA_LC3B ? lc3b_isa_t::pc_step : lc3_isa_t::pc_step;
+    return addr < block->start + block->length * step ? block : 0;
+}
+
+word_t image_load(const image_t *image, machine_t *m)
+{
+    SPAN_BEGIN(begin);
+    int shift = image->header->isa == ISA_LC3B ? lc3b_isa_t::offset_shift : lc3_isa_t::offset_shift;
+    uint32_t limit = DEVICE_REGISTER_ADDR >> shift;
+    for(uint32_t i = 0; i < image->header->segment_count; ++i)
+    {
+        const image_segment_t &segment = image->segments[i];
+        uint32_t first = segment.addr >> shift;
+        uint32_t words = segment.words;
+        if(first >= limit)
+            continue;
+        if(first + words > limit)
+            words = limit - first;
+        memcpy(m->mem + first, image_segment_data(image, &segment), words * sizeof(word_t));
+    }
+    //mem changed under the cache, map the code pages again before the run.
+    if(m->decode)
+    {
+        uint8_t code_pages[PAGE_COUNT];
+        image_code_pages(image, code_pages, PAGE_COUNT);
+        decode_cache_reset(m->decode);
+        decode_cache_warm(m->decode, m->mem, code_pages, PAGE_COUNT);
+    }
+    m->pc = image->header->entry;
+    SPAN_END(begin, SPAN_IMAGE_LOAD, image->header->segment_count);
+    return m->pc;
+}
+
+void image_code_pages(const image_t *image, uint8_t *code_pages, uint32_t page_count)
+{
+    int shift = image->header->isa == ISA_LC3B ? lc3b_isa_t::offset_shift : lc3_isa_t::offset_shift;
+    memset(code_pages, 0, page_count);
+    for(uint32_t i = 0; i < image->header->segment_count; ++i)
+    {
+        const image_segment_t &segment = image->segments[i];
+        if(!(segment.flags & SECTION_CODE) || !segment.words)
+            continue;
+        uint32_t first = segment.addr >> shift;
+        for(uint32_t page = first >> 8; page <= (first + segment.words - 1) >> 8 && page < page_count; ++page)
+            code_pages[page] = 1;
+    }
+}
+
+void image_build_init(image_build_t *build, isa_variant_t isa)
+{
+    build->isa = isa;
+    build->entry = USER_SPACE_ADDR;
+    build->segments.clear();
+    build->symbols.clear();
+    build->names.clear();
+}
+
+void image_build_add_obj(image_build_t *build, const uint8_t *data, uint32_t len, uint16_t flags)
+{
+    if(len < 2)
+        return;
+
+    image_build_segment_t segment;
+    segment.addr = (word_t)((data[0] << 8) | data[1]);
+    segment.flags = flags;
+    for(uint32_t i = 2; i + 1 < len; i += 2)
+        segment.words.push_back((word_t)((data[i] << 8) | data[i + 1]));
+
+    if(build->segments.empty())
+        build->entry = segment.addr;
+    build->segments.push_back(segment);
+}
+
+void image_build_add_symbol(image_build_t *build, word_t addr, const char *name)
+{
+    image_build_symbol_t symbol;
+    symbol.addr = addr;
+    symbol.flags = 0;
+    symbol.name_offset = (uint32_t)build->names.size();
+    build->names.insert(build->names.end(), name, name + strlen(name) + 1);
+    build->symbols.push_back(symbol);
+}
+
+//FNV-1a over the address and words of every segment.
+static uint64_t image_hash(const image_build_t *build)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(const image_build_segment_t &segment : build->segments)
+    {
+        h = (h ^ segment.addr) * 0x100000001b3ULL;
+        for(word_t w : segment.words)
+            h = (h ^ w) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+template<typename isa_t>
+static bool ends_block(word_t ir)
+{
+    op_t op = isa_t::opcode_map[ir >> 12];
+    if(op == OP_BR)
+        return (ir >> 9) & 0x7;
+    return op == OP_JSR || op == OP_JMP || op == OP_RTI || op == OP_TRAP || op == OP_RESERVED;
+}
+
+template<typename isa_t>
+static void add_successors(word_t pc, word_t ir, std::vector<image_edge_t> *edges)
+{
+    const int shift = isa_t::offset_shift;
+    word_t next = pc + isa_t::pc_step;
+    image_edge_t edge;
+    edge.block = INVALID_INDEX;
+
+    switch(isa_t::opcode_map[ir >> 12])
+    {
+    case OP_BR:
+    {
+        word_t nzp = (ir >> 9) & 0x7;
+        if(nzp)
+        {
+            edge.target = next + (word_t)(sign_extend(ir, 9) << shift);
+            edge.kind = EDGE_TAKEN;
+            edges->push_back(edge);
+        }
+        if(nzp != 0x7)
+        {
+            edge.target = next;
+            edge.kind = EDGE_FALLTHROUGH;
+            edges->push_back(edge);
+        }
+        break;
+    }
+    case OP_JSR:
+        edge.target = (ir & 0x0800) ? next + (word_t)(sign_extend(ir, 11) << shift) : 0;
+        edge.kind = (ir & 0x0800) ? EDGE_CALL : EDGE_CALL | EDGE_INDIRECT;
+        edges->push_back(edge);
+        edge.target = next;
+        edge.kind = EDGE_FALLTHROUGH;
+        edges->push_back(edge);
+        break;
+    case OP_JMP:
+    case OP_RTI:
+    case OP_RESERVED:
+        edge.target = 0;
+        edge.kind = EDGE_INDIRECT;
+        edges->push_back(edge);
+        break;
+    case OP_TRAP:
+        if((ir & 0xFF) != HALT)
+        {
+            edge.target = next;
+            edge.kind = EDGE_FALLTHROUGH;
+            edges->push_back(edge);
+        }
+        break;
+    default:
+        edge.target = next;
+        edge.kind = EDGE_FALLTHROUGH;
+        edges->push_back(edge);
+        break;
+    }
+}
+
+/*
+function define:
+    leaders are the entry, segment starts, branch and call targets
+    and every instruction after one that ends a block
+*/
+template<typename isa_t>
+static void build_blocks(const image_build_t *build, const std::vector<uint32_t> &symbol_order,
+                         std::vector<image_block_t> *blocks, std::vector<image_edge_t> *edges)
+{
+    const uint32_t step = isa_t::pc_step;
+    std::vector<uint8_t> code(0x10000, 0);
+    std::vector<uint8_t> leader(0x10000, 0);
+    std::vector<word_t> text(0x10000, 0);
+
+    for(const image_build_segment_t &segment : build->segments)
+    {
+        if(!(segment.flags & SECTION_CODE))
+            continue;
+        uint32_t addr = segment.addr;
+        for(word_t w : segment.words)
+        {
+            if(addr > 0xFFFF)
+                break;
+            code[addr] = 1;
+            text[addr] = w;
+            addr += step;
+        }
+        leader[segment.addr] = 1;
+    }
+    leader[build->entry] = 1;
+
+    std::vector<image_edge_t> successors;
+    for(uint32_t addr = 0; addr <= 0xFFFF; addr += step)
+    {
+        if(!code[addr] || !ends_block<isa_t>(text[addr]))
+            continue;
+        successors.clear();
+        add_successors<isa_t>((word_t)addr, text[addr], &successors);
+        for(const image_edge_t &edge : successors)
+        {
+            if(!(edge.kind & EDGE_INDIRECT))
+                leader[edge.target] = 1;
+        }
+        if(addr + step <= 0xFFFF)
+            leader[addr + step] = 1;
+    }
+
+    std::vector<uint32_t> block_of(0x10000, INVALID_INDEX);
+    for(uint32_t addr = 0; addr <= 0xFFFF; addr += step)
+    {
+        if(!code[addr])
+            continue;
+        bool start = leader[addr] || addr < step || !code[addr - step];
+        if(start || blocks->back().length == UINT16_MAX)
+        {
+            image_block_t block;
+            block.start = (uint16_t)addr;
+            block.length = 0;
+            block.first_edge = 0;
+            block.edge_count = 0;
+            block.symbol = INVALID_INDEX;
+            block_of[addr] = (uint32_t)blocks->size();
+            blocks->push_back(block);
+        }
+        ++blocks->back().length;
+    }
+
+    for(uint32_t i = 0; i < symbol_order.size(); ++i)
+    {
+        uint32_t b = block_of[build->symbols[symbol_order[i]].addr];
+        if(b != INVALID_INDEX && (*blocks)[b].symbol == INVALID_INDEX)
+            (*blocks)[b].symbol = i;
+    }
+
+    for(image_block_t &block : *blocks)
+    {
+        word_t last = (word_t)(block.start + (block.length - 1) * step);
+        block.first_edge = (uint32_t)edges->size();
+        add_successors<isa_t>(last, text[last], edges);
+        block.edge_count = (uint32_t)edges->size() - block.first_edge;
+    }
+    for(image_edge_t &edge : *edges)
+    {
+        if(!(edge.kind & EDGE_INDIRECT))
+            edge.block = block_of[edge.target];
+    }
+}
+
+void image_serialize(const image_build_t *build, std::vector<uint8_t> *out)
+{
+    std::multimap<word_t, uint32_t> by_addr;
+    for(uint32_t i = 0; i < build->symbols.size(); ++i)
+        by_addr.insert({build->symbols[i].addr, i});
+    std::vector<uint32_t> symbol_order;
+    for(auto &entry : by_addr)
+        symbol_order.push_back(entry.second);
+
+    std::vector<image_block_t> blocks;
+    std::vector<image_edge_t> edges;
+    if(build->isa == ISA_LC3B)
+        build_blocks<lc3b_isa_t>(build, symbol_order, &blocks, &edges);
+    else
+        build_blocks<lc3_isa_t>(build, symbol_order, &blocks, &edges);
+
+    image_header_t h;
+    memset(&h, 0, sizeof(h));
+    h.magic = IMAGE_MAGIC;
+    h.version = IMAGE_VERSION;
+    h.isa = (uint16_t)build->isa;
+    h.entry = build->entry;
+    h.segment_count = (uint16_t)build->segments.size();
+    h.symbol_count = (uint32_t)symbol_order.size();
+    h.block_count = (uint32_t)blocks.size();
+    h.edge_count = (uint32_t)edges.size();
+    h.segment_offset = align8(sizeof(image_header_t));
+    h.symbol_offset = align8(h.segment_offset + h.segment_count * sizeof(image_segment_t));
+    h.block_offset = align8(h.symbol_offset + h.symbol_count * sizeof(image_symbol_t));
+    h.edge_offset = align8(h.block_offset + h.block_count * sizeof(image_block_t));
+    h.string_offset = align8(h.edge_offset + h.edge_count * sizeof(image_edge_t));
+    h.string_size = (uint32_t)build->names.size();
+    h.hash = image_hash(build);
+
+    uint32_t data_offset = align8(h.string_offset + h.string_size);
+    std::vector<image_segment_t> segments;
+    for(const image_build_segment_t &s : build->segments)
+    {
+        image_segment_t segment;
+        segment.addr = s.addr;
+        segment.flags = s.flags;
+        segment.words = (uint32_t)s.words.size();
+        segment.data_offset = data_offset;
+        segment.reserved = 0;
+        segments.push_back(segment);
+        data_offset = align8(data_offset + segment.words * sizeof(word_t));
+    }
+
+    out->assign(data_offset, 0);
+    uint8_t *base = out->data();
+    memcpy(base, &h, sizeof(h));
+    if(!segments.empty())
+        memcpy(base + h.segment_offset, segments.data(), segments.size() * sizeof(image_segment_t));
+    image_symbol_t *symbols = (image_symbol_t *)(base + h.symbol_offset);
+    for(uint32_t i = 0; i < symbol_order.size(); ++i)
+    {
+        const image_build_symbol_t &s = build->symbols[symbol_order[i]];
+        symbols[i].addr = s.addr;
+        symbols[i].flags = s.flags;
+        symbols[i].name_offset = s.name_offset;
+    }
+    if(!blocks.empty())
+        memcpy(base + h.block_offset, blocks.data(), blocks.size() * sizeof(image_block_t));
+    if(!edges.empty())
+        memcpy(base + h.edge_offset, edges.data(), edges.size() * sizeof(image_edge_t));
+    if(!build->names.empty())
+        memcpy(base + h.string_offset, build->names.data(), build->names.size());
+    for(uint32_t i = 0; i < segments.size(); ++i)
+    {
+        if(!build->segments[i].words.empty())
+            memcpy(base + segments[i].data_offset, build->segments[i].words.data(),
+                   segments[i].words * sizeof(word_t));
+    }
+}
+
+bool image_write(const image_build_t *build, const char *path)
+{
+    std::vector<uint8_t> bytes;
+    image_serialize(build, &bytes);
+
+    FILE *out = fopen(path, "wb");
+    if(!out)
+        return false;
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+    return fclose(out) == 0 && ok;
+}
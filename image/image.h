@@ -0,0 +1,175 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include<vector>
+
+#include"../type/type.h"
+#include"../engine/isa.h"
+#include"../engine/machine.h"
+
+/*
+program image container, an alternative to the plain .obj format
+layout, every table aligned to 8 bytes and addressed by file offset:
+    image_header_t
+    image_segment_t[segment_count]
+    image_symbol_t[symbol_count]    sorted by addr
+    image_block_t[block_count]      sorted by start
+    image_edge_t[edge_count]
+    string pool, NUL terminated names
+    segment words, host byte order
+the tables are used in place from a read only mapping, nothing is parsed.
+*/
+
+//"LC3I"
+#define IMAGE_MAGIC 0x4933434C
+#define IMAGE_VERSION 1
+
+#define SECTION_CODE 0x0001
+#define SECTION_DATA 0x0002
+#define SECTION_READONLY 0x0004
+
+#define EDGE_FALLTHROUGH 0x0001
+#define EDGE_TAKEN 0x0002
+#define EDGE_CALL 0x0004
+//JMP, JSRR, RTI, the target is only known at run time.
+#define EDGE_INDIRECT 0x0008
+
+#define INVALID_INDEX UINT32_MAX
+
+struct image_header_t
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t isa;
+    uint16_t entry;
+    uint16_t segment_count;
+    uint32_t symbol_count;
+    uint32_t block_count;
+    uint32_t edge_count;
+    uint32_t segment_offset;
+    uint32_t symbol_offset;
+    uint32_t block_offset;
+    uint32_t edge_offset;
+    uint32_t string_offset;
+    uint32_t string_size;
+    //content hash of the load segments, identifies the program.
+    uint64_t hash;
+};
+
+struct image_segment_t
+{
+    uint16_t addr;
+    uint16_t flags;
+    uint32_t words;
+    uint32_t data_offset;
+    uint32_t reserved;
+};
+
+struct image_symbol_t
+{
+    uint16_t addr;
+    uint16_t flags;
+    uint32_t name_offset;
+};
+
+//basic block, length counts instructions.
+struct image_block_t
+{
+    uint16_t start;
+    uint16_t length;
+    uint32_t first_edge;
+    uint32_t edge_count;
+    //symbol naming the block start, INVALID_INDEX if none.
+    uint32_t symbol;
+};
+
+struct image_edge_t
+{
+    uint16_t target;
+    uint16_t kind;
+    //index of the target block, INVALID_INDEX when indirect or outside the image.
+    uint32_t block;
+};
+
+//typed view of an image in memory.
+struct image_t
+{
+    const uint8_t *base;
+    uint64_t size;
+    bool mapped;
+
+    const image_header_t *header;
+    const image_segment_t *segments;
+    const image_symbol_t *symbols;
+    const image_block_t *blocks;
+    const image_edge_t *edges;
+    const char *strings;
+};
+
+//map the file read only, return false if it is not a valid image.
+bool image_open(image_t *image, const char *path);
+
+//view an image already in memory, the bytes must stay valid and 8 byte aligned.
+bool image_view(image_t *image, const uint8_t *data, uint64_t size);
+
+void image_close(image_t *image);
+
+inline const word_t *image_segment_data(const image_t *image, const image_segment_t *segment)
+{
+    return (const word_t *)(image->base + segment->data_offset);
+}
+
+inline const char *image_symbol_name(const image_t *image, const image_symbol_t *symbol)
+{
+    return image->strings + symbol->name_offset;
+}
+
+//nearest symbol at or below addr, 0 if none.
+const image_symbol_t *image_symbol_at(const image_t *image, word_t addr);
+
+//block holding addr, 0 if addr is not in a code segment.
+const image_block_t *image_block_at(const image_t *image, word_t addr);
+
+//copy the segments into m->mem and set the PC to the entry point,
+//with m->decode set the code pages are decoded ahead of the run.
+word_t image_load(const image_t *image, machine_t *m);
+
+//flag the mem pages, 256 words each, that hold code.
+void image_code_pages(const image_t *image, uint8_t *code_pages, uint32_t page_count);
+
+struct image_build_segment_t
+{
+    word_t addr;
+    uint16_t flags;
+    std::vector<word_t> words;
+};
+
+struct image_build_symbol_t
+{
+    word_t addr;
+    uint16_t flags;
+    uint32_t name_offset;
+};
+
+struct image_build_t
+{
+    isa_variant_t isa;
+    word_t entry;
+    std::vector<image_build_segment_t> segments;
+    std::vector<image_build_symbol_t> symbols;
+    std::vector<char> names;
+};
+
+void image_build_init(image_build_t *build, isa_variant_t isa);
+
+//add a .obj image as one segment, the first one added sets the entry point.
+void image_build_add_obj(image_build_t *build, const uint8_t *data, uint32_t len, uint16_t flags);
+
+void image_build_add_symbol(image_build_t *build, word_t addr, const char *name);
+
+//lay out the tables, derive the basic blocks and CFG of the code segments.
+void image_serialize(const image_build_t *build, std::vector<uint8_t> *out);
+
+bool image_write(const image_build_t *build, const char *path);
+
+#endif //IMAGE_H
@@ -0,0 +1,122 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"image.h"
+#include"../engine/decode_cache.h"
+#include"../test/check.h"
+
+static const char *path = "image_test.img";
+
+/*
+x3000 AND R1,R1,#0; ADD R1,R1,#3
+x3002 LOOP ADD R0,R0,#1; ADD R1,R1,#-1; BRp LOOP
+x3005 JSR SUB
+x3006 HALT
+x3007 SUB RET
+*/
+static const uint8_t code_obj[] =
+{
+    0x30, 0x00,
+    0x52, 0x60, 0x12, 0x63, 0x10, 0x21, 0x12, 0x7F, 0x03, 0xFD, 0x48, 0x01, 0xF0, 0x25, 0xC1, 0xC0
+};
+static const uint8_t data_obj[] = {0x40, 0x00, 0x12, 0x34, 0x56, 0x78};
+
+int main()
+{
+    image_build_t build;
+    image_build_init(&build, ISA_LC3);
+    image_build_add_obj(&build, code_obj, sizeof(code_obj), SECTION_CODE | SECTION_READONLY);
+    image_build_add_obj(&build, data_obj, sizeof(data_obj), SECTION_DATA);
+    image_build_add_symbol(&build, 0x4000, "TABLE");
+    image_build_add_symbol(&build, 0x3007, "SUB");
+    image_build_add_symbol(&build, 0x3002, "LOOP");
+
+    std::vector<uint8_t> bytes;
+    image_serialize(&build, &bytes);
+    //image_view wants 8 byte alignment.
+    std::vector<uint64_t> buffer((bytes.size() + 7) / 8);
+    memcpy(buffer.data(), bytes.data(), bytes.size());
+    const uint8_t *data = (const uint8_t *)buffer.data();
+
+    image_t image;
+    CHECK(image_view(&image, data, bytes.size()));
+    CHECK(image.header->entry == 0x3000 && image.header->segment_count == 2);
+    CHECK(image.segments[1].addr == 0x4000 && image.segments[1].words == 2);
+    CHECK(image_segment_data(&image, &image.segments[1])[1] == 0x5678);
+
+    //symbols come back sorted by address.
+    CHECK(image.header->symbol_count == 3);
+    CHECK(!strcmp(image_symbol_name(&image, &image.symbols[0]), "LOOP"));
+    CHECK(!strcmp(image_symbol_name(&image, image_symbol_at(&image, 0x3004)), "LOOP"));
+    CHECK(!strcmp(image_symbol_name(&image, image_symbol_at(&image, 0x4001)), "TABLE"));
+    CHECK(image_symbol_at(&image, 0x2FFF) == 0);
+
+    //blocks start at x3000, LOOP, after BRp, after JSR and at SUB.
+    CHECK(image.header->block_count == 5);
+    const image_block_t *loop = image_block_at(&image, 0x3004);
+    CHECK(loop && loop->start == 0x3002 && loop->length == 3);
+    CHECK(loop && loop->symbol != INVALID_INDEX && image.symbols[loop->symbol].addr == 0x3002);
+    CHECK(image_block_at(&image, 0x4000) == 0);
+    if(loop)
+    {
+        CHECK(loop->edge_count == 2);
+        const image_edge_t *edges = &image.edges[loop->first_edge];
+        CHECK(edges[0].kind == EDGE_TAKEN && edges[0].target == 0x3002 && &image.blocks[edges[0].block] == loop);
+        CHECK(edges[1].kind == EDGE_FALLTHROUGH && edges[1].target == 0x3005);
+    }
+    const image_block_t *call = image_block_at(&image, 0x3005);
+    CHECK(call && call->edge_count == 2 && image.edges[call->first_edge].kind == EDGE_CALL);
+    CHECK(call && image.blocks[image.edges[call->first_edge].block].start == 0x3007);
+    CHECK(image_block_at(&image, 0x3006)->edge_count == 0);
+    CHECK(image.edges[image_block_at(&image, 0x3007)->first_edge].kind == EDGE_INDIRECT);
+
+    uint8_t code_pages[0x100];
+    image_code_pages(&image, code_pages, sizeof(code_pages));
+    CHECK(code_pages[0x30] && !code_pages[0x40] && !code_pages[0x31]);
+
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    machine_t *m = new machine_t();
+    machine_init(m, ISA_LC3, mem.data());
+    CHECK(image_load(&image, m) == 0x3000);
+    CHECK(mem[0x4000] == 0x1234);
+    machine_run(m, 100);
+    CHECK(m->state == MACHINE_HALTED && m->reg[0] == 3);
+
+    //a machine with a decode cache gets its code pages mapped by the load.
+    decode_store_t store;
+    decode_store_init(&store);
+    decode_cache_t *cache = new decode_cache_t();
+    decode_cache_init(cache, &store, ISA_LC3, image.header->hash);
+    mem.assign(mem.size(), 0);
+    machine_init(m, ISA_LC3, mem.data());
+    m->decode = cache;
+    image_load(&image, m);
+    CHECK(cache->page[0x30] && !cache->page[0x40] && store.misses == 1);
+    machine_run(m, 100);
+    CHECK(m->state == MACHINE_HALTED && m->reg[0] == 3 && store.misses == 1);
+    decode_cache_destroy(cache);
+    delete cache;
+    decode_store_destroy(&store);
+    delete m;
+
+    //a wrong magic and a cut off segment are refused.
+    image_t bad;
+    CHECK(!image_view(&bad, data, bytes.size() - 8));
+    CHECK(!image_view(&bad, data, sizeof(image_header_t) - 1));
+    ((image_header_t *)buffer.data())->magic ^= 1;
+    CHECK(!image_view(&bad, data, bytes.size()));
+
+    //through a file and mmap.
+    CHECK(image_write(&build, path));
+    image_t mapped;
+    CHECK(image_open(&mapped, path));
+    if(mapped.base)
+    {
+        CHECK(mapped.mapped && mapped.header->hash == image.header->hash);
+        image_close(&mapped);
+    }
+    remove(path);
+
+    return check_result();
+}
@@ -0,0 +1,21 @@
+#ifndef ADDRESS_H
+#define ADDRESS_H
+
+//LC-3 memory map, kept apart from memory.h so headers can use it without
+//defining the mem globals.
+#define SYSTEM_SPACE_ADDR 0x0000
+#define SYSTEM_SPACE_LIMIT 0x2FFF
+
+#define TRAP_VECTOR_ADDR 0x0000
+#define TRAP_VECTOR_LIMIT 0x00FF
+
+#define INTERRUPT_VECTOR_TABLE_ADDR 0x0100
+#define INTERRUPT_VECTOR_TABLE_LIMIT 0x01FF
+
+#define USER_SPACE_ADDR 0x3000
+#define USER_SPACE_LIMIT 0xFDFF
+
+#define DEVICE_REGISTER_ADDR 0xFE00
+#define DEVICE_REGSITER_LIMIT 0xFFFF
+
+#endif //ADDRESS_H
\ No newline at end of file
@@ -2,8 +2,7 @@
 #define CONTROL_STORE_H
 
 #include"../type/type.h"
-
-typedef uint64_t micro_instruction_t;
+#include"micro_instruction.h"
 
 micro_instruction_t control_store[0x40];
 
@@ -18,5 +17,4 @@ struct control_signals
     uint8_t IRD;    
 };
 
-
 #endif //CONTROL_STORE_H
\ No newline at end of file
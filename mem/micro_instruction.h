@@ -0,0 +1,27 @@
+#ifndef MICRO_INSTRUCTION_H
+#define MICRO_INSTRUCTION_H
+
+#include"../type/type.h"
+
+typedef uint64_t micro_instruction_t;
+
+//microsequencer fields of a micro instruction, datapath signals sit above bit 9.
+#define MICRO_J(u) (uint8_t)((u) & 0x3F)
+#define MICRO_COND(u) (uint8_t)(((u) >> 6) & 0x7)
+#define MICRO_IRD(u) (uint8_t)(((u) >> 9) & 0x1)
+#define MICRO_WORD(ird, cond, j) (micro_instruction_t)(((ird) << 9) | ((cond) << 6) | (j))
+
+//COND, the bit of J it may set: next state = J | condition << bit.
+#define COND_NONE 0x0
+//memory ready, J[1].
+#define COND_R 0x1
+//branch enable, J[2].
+#define COND_BEN 0x2
+//addressing mode IR[11], J[0].
+#define COND_IR11 0x3
+//privilege PSR[15], J[3].
+#define COND_PSR 0x4
+//interrupt request, J[4].
+#define COND_INT 0x5
+
+#endif //MICRO_INSTRUCTION_H
\ No newline at end of file
@@ -0,0 +1,532 @@
+#include<string.h>
+
+#include"memo.h"
+#include"../engine/engine.h"
+#include"../profile/span.h"
+
+//a call being recorded, from its target until the PC is back at link with R6 at sp.
+struct memo_recorder_t
+{
+    word_t target;
+    word_t link;
+    word_t sp;
+    reg_t entry_reg[0x8];
+    word_t entry_cc;
+
+    uint8_t read_mask;
+    uint8_t written_mask;
+    uint8_t cc_read;
+    uint8_t cc_written;
+    std::unordered_map<word_t, word_t> inputs;
+    std::unordered_map<word_t, word_t> writes;
+
+    uint64_t start_instructions;
+    uint64_t start_cycles;
+    uint64_t start_opcode_count[16];
+};
+
+//registers, CC and memory one instruction touches, taken before it runs.
+struct memo_access_t
+{
+    uint8_t reg_read;
+    uint8_t reg_write;
+    uint8_t cc_read;
+    uint8_t cc_write;
+    uint8_t reads;
+    word_t read_addr[3];
+    uint8_t writes;
+    word_t write_addr;
+    bool impure;
+};
+
+#define REG_BIT(r) (uint8_t)(1 << (r))
+
+template<typename isa_t>
+static word_t peek(const machine_t *m, word_t addr)
+{
+    return m->mem[addr >> isa_t::offset_shift];
+}
+
+template<typename isa_t>
+static void access_read(memo_access_t *a, word_t addr)
+{
+    addr &= ~(isa_t::pc_step - 1);
+    if(addr >= DEVICE_REGISTER_ADDR)
+        a->impure = true;
+    else
+        a->read_addr[a->reads++] = addr;
+}
+
+template<typename isa_t>
+static void access_write(memo_access_t *a, word_t addr)
+{
+    addr &= ~(isa_t::pc_step - 1);
+    if(addr >= DEVICE_REGISTER_ADDR)
+        a->impure = true;
+    a->writes = 1;
+    a->write_addr = addr;
+}
+
+template<typename isa_t>
+static void memo_access(const machine_t *m, word_t pc, word_t ir, memo_access_t *a)
+{
+    memset(a, 0, sizeof(*a));
+    decoded_t d = decode_word<isa_t>(ir);
+    op_t op = isa_t::opcode_map[ir >> 12];
+    word_t next = pc + isa_t::pc_step;
+    const reg_t *reg = m->reg;
+
+    //the fetch is a read as well, code may change between calls.
+    access_read<isa_t>(a, pc);
+
+    switch(op)
+    {
+    case OP_BR:
+        a->cc_read = d.dr != 0;
+        break;
+    case OP_ADD:
+    case OP_AND:
+    case OP_XOR:
+        a->reg_read = REG_BIT(d.sr1) | ((d.flags & DECODED_IMM) ? 0 : REG_BIT(d.sr2));
+        a->reg_write = REG_BIT(d.dr);
+        a->cc_write = 1;
+        break;
+    case OP_NOT:
+    case OP_SHF:
+        a->reg_read = REG_BIT(d.sr1);
+        a->reg_write = REG_BIT(d.dr);
+        a->cc_write = 1;
+        break;
+    case OP_LD:
+        access_read<isa_t>(a, next + d.imm);
+        a->reg_write = REG_BIT(d.dr);
+        a->cc_write = 1;
+        break;
+    case OP_LDI:
+    {
+        word_t pointer = next + d.imm;
+        access_read<isa_t>(a, pointer);
+        if(!a->impure)
+            access_read<isa_t>(a, peek<isa_t>(m, pointer));
+        a->reg_write = REG_BIT(d.dr);
+        a->cc_write = 1;
+        break;
+    }
+    case OP_LDR:
+    case OP_LDW:
+    case OP_LDB:
+        access_read<isa_t>(a, reg[d.sr1] + d.imm);
+        a->reg_read = REG_BIT(d.sr1);
+        a->reg_write = REG_BIT(d.dr);
+        a->cc_write = 1;
+        break;
+    case OP_LEA:
+        a->reg_write = REG_BIT(d.dr);
+        a->cc_write = isa_t::lea_sets_cc;
+        break;
+    case OP_ST:
+        access_write<isa_t>(a, next + d.imm);
+        a->reg_read = REG_BIT(d.dr);
+        break;
+    case OP_STI:
+    {
+        word_t pointer = next + d.imm;
+        access_read<isa_t>(a, pointer);
+        if(!a->impure)
+            access_write<isa_t>(a, peek<isa_t>(m, pointer));
+        a->reg_read = REG_BIT(d.dr);
+        break;
+    }
+    case OP_STR:
+    case OP_STW:
+    case OP_STB:
+        access_write<isa_t>(a, reg[d.sr1] + d.imm);
+        a->reg_read = REG_BIT(d.dr) | REG_BIT(d.sr1);
+        break;
+    case OP_JSR:
+        a->reg_read = (d.flags & DECODED_IMM) ? 0 : REG_BIT(d.sr1);
+        a->reg_write = REG_BIT(7);
+        break;
+    case OP_JMP:
+        a->reg_read = REG_BIT(d.sr1);
+        break;
+    default:
+        //TRAP, RTI and reserved opcodes leave the subroutine.
+        a->impure = true;
+        break;
+    }
+}
+
+//what recording one more access did to a call.
+enum record_status_t
+{
+    RECORD_OK,
+    //the call outgrew a recorder limit, only this call is not recorded.
+    RECORD_FULL,
+    //the call has a side effect, its target is never recorded again.
+    RECORD_IMPURE
+};
+
+//stop recording call i, an impure call marks its target as well.
+static void recorder_abort(memo_t *memo, uint32_t i, bool impure)
+{
+    memo_recorder_t *r = memo->recorders[i];
+    if(impure)
+        memo->targets[r->target].impure = true;
+    ++memo->aborted;
+    delete r;
+    memo->recorders.erase(memo->recorders.begin() + i);
+}
+
+static void recorder_abort_all(memo_t *memo)
+{
+    while(!memo->recorders.empty())
+        recorder_abort(memo, (uint32_t)memo->recorders.size() - 1, true);
+}
+
+//an interrupt arrived inside the calls, they are dropped but stay cacheable.
+static void recorder_drop_all(memo_t *memo)
+{
+    for(memo_recorder_t *r : memo->recorders)
+        delete r;
+    memo->recorders.clear();
+}
+
+static bool in_frame(const memo_recorder_t *r, word_t addr)
+{
+    word_t below = r->sp - addr;
+    return below != 0 && below <= MEMO_STACK_SPAN;
+}
+
+static void recorder_read_regs(memo_recorder_t *r, uint8_t mask, uint8_t cc)
+{
+    r->read_mask |= mask & ~r->written_mask;
+    if(cc && !r->cc_written)
+        r->cc_read = 1;
+}
+
+static record_status_t recorder_read_mem(memo_recorder_t *r, word_t addr, word_t value)
+{
+    if(r->writes.count(addr) || r->inputs.count(addr))
+        return RECORD_OK;
+    if(r->inputs.size() >= MEMO_MAX_INPUTS)
+        return RECORD_FULL;
+    r->inputs[addr] = value;
+    return RECORD_OK;
+}
+
+static record_status_t recorder_write_mem(memo_recorder_t *r, word_t addr, word_t value)
+{
+    if(!in_frame(r, addr))
+        return RECORD_IMPURE;
+    if(!r->writes.count(addr) && r->writes.size() >= MEMO_MAX_WRITES)
+        return RECORD_FULL;
+    r->writes[addr] = value;
+    return RECORD_OK;
+}
+
+static uint64_t key_hash(uint8_t read_mask, uint8_t cc_read, const reg_t *reg, word_t cc)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = (h ^ read_mask ^ (cc_read << 8)) * 0x100000001b3ULL;
+    for(int r = 0; r < 8; ++r)
+    {
+        if(read_mask & REG_BIT(r))
+            h = (h ^ reg[r]) * 0x100000001b3ULL;
+    }
+    if(cc_read)
+        h = (h ^ cc) * 0x100000001b3ULL;
+    return h;
+}
+
+static void recorder_finish(machine_t *m, memo_t *memo, memo_recorder_t *r)
+{
+    memo_target_t &target = memo->targets[r->target];
+    if(target.impure || target.entries.size() >= MEMO_MAX_ENTRIES)
+        return;
+
+    memo_entry_t entry;
+    entry.read_mask = r->read_mask;
+    entry.cc_read = r->cc_read;
+    memcpy(entry.in_reg, r->entry_reg, sizeof(entry.in_reg));
+    entry.in_cc = r->entry_cc;
+    for(auto &cell : r->inputs)
+        entry.inputs.push_back({cell.first, cell.second});
+
+    entry.write_mask = r->written_mask;
+    entry.cc_written = r->cc_written;
+    memcpy(entry.out_reg, m->reg, sizeof(entry.out_reg));
+    entry.out_cc = m->psr & PSR_CC;
+    for(auto &cell : r->writes)
+        entry.writes.push_back({cell.first, cell.second});
+
+    entry.instructions = m->instructions - r->start_instructions;
+    entry.cycles = m->cycles - r->start_cycles;
+    for(int i = 0; i < 16; ++i)
+        entry.opcode_count[i] = (uint32_t)(m->opcode_count[i] - r->start_opcode_count[i]);
+
+    uint16_t mask = (uint16_t)(entry.read_mask | (entry.cc_read << 8));
+    bool known = false;
+    for(uint16_t k : target.masks)
+        known = known || k == mask;
+    if(!known)
+        target.masks.push_back(mask);
+
+    target.index.insert({key_hash(entry.read_mask, entry.cc_read, entry.in_reg, entry.in_cc),
+                         (uint32_t)target.entries.size()});
+    target.entries.push_back(entry);
+    ++memo->recorded;
+}
+
+//the PC is back at the link of a recorder with its R6, the call is complete.
+static void memo_returns(machine_t *m, memo_t *memo, bool deep)
+{
+    while(!memo->recorders.empty())
+    {
+        int i = (int)memo->recorders.size() - 1;
+        for(; i >= 0; --i)
+        {
+            memo_recorder_t *r = memo->recorders[i];
+            if(m->pc == r->link && m->reg[6] == r->sp)
+                break;
+            if(!deep)
+            {
+                i = -1;
+                break;
+            }
+        }
+        if(i < 0)
+            return;
+
+        recorder_finish(m, memo, memo->recorders[i]);
+        //calls above it never returned, they are dropped.
+        while((int)memo->recorders.size() > i)
+        {
+            delete memo->recorders.back();
+            memo->recorders.pop_back();
+        }
+    }
+}
+
+template<typename isa_t>
+static const memo_entry_t *memo_lookup(machine_t *m, memo_target_t *target)
+{
+    word_t cc = m->psr & PSR_CC;
+    for(uint16_t mask : target->masks)
+    {
+        uint8_t read_mask = (uint8_t)mask;
+        uint8_t cc_read = (uint8_t)(mask >> 8);
+        auto range = target->index.equal_range(key_hash(read_mask, cc_read, m->reg, cc));
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            const memo_entry_t &entry = target->entries[it->second];
+            if(entry.read_mask != read_mask || entry.cc_read != cc_read ||
+               (cc_read && entry.in_cc != cc))
+                continue;
+
+            bool match = true;
+            for(int r = 0; r < 8 && match; ++r)
+                match = !(read_mask & REG_BIT(r)) || entry.in_reg[r] == m->reg[r];
+            for(uint32_t i = 0; i < entry.inputs.size() && match; ++i)
+                match = peek<isa_t>(m, entry.inputs[i].addr) == entry.inputs[i].value;
+            if(match)
+                return &entry;
+        }
+    }
+    return 0;
+}
+
+//the effects of a replayed call belong to every call still being recorded.
+static void recorders_merge(memo_t *memo, const memo_entry_t *entry)
+{
+    for(uint32_t i = 0; i < memo->recorders.size(); )
+    {
+        memo_recorder_t *r = memo->recorders[i];
+        recorder_read_regs(r, entry->read_mask, entry->cc_read);
+        record_status_t status = RECORD_OK;
+        for(uint32_t k = 0; k < entry->inputs.size() && status == RECORD_OK; ++k)
+            status = recorder_read_mem(r, entry->inputs[k].addr, entry->inputs[k].value);
+        for(uint32_t k = 0; k < entry->writes.size() && status == RECORD_OK; ++k)
+            status = recorder_write_mem(r, entry->writes[k].addr, entry->writes[k].value);
+        r->written_mask |= entry->write_mask;
+        r->cc_written |= entry->cc_written;
+
+        if(status == RECORD_OK)
+            ++i;
+        else
+            recorder_abort(memo, i, status == RECORD_IMPURE);
+    }
+}
+
+template<typename isa_t>
+static void memo_replay(machine_t *m, const memo_entry_t *entry, word_t link)
+{
+    for(int r = 0; r < 8; ++r)
+    {
+        if(entry->write_mask & REG_BIT(r))
+            m->reg[r] = entry->out_reg[r];
+    }
+    if(entry->cc_written)
+        m->psr = (m->psr & ~PSR_CC) | entry->out_cc;
+    for(const memo_cell_t &cell : entry->writes)
+        mem_write<isa_t>(m, cell.addr, cell.value);
+
+    m->pc = link;
+    m->instructions += entry->instructions;
+    m->cycles += entry->cycles;
+    for(int i = 0; i < 16; ++i)
+        m->opcode_count[i] += entry->opcode_count[i];
+}
+
+//a JSR or JSRR just ran, the PC is at its target and R7 holds the link.
+template<typename isa_t>
+static void memo_call(machine_t *m, memo_t *memo, uint64_t limit)
+{
+    ++memo->calls;
+    word_t target_pc = m->pc;
+    if(target_pc >= DEVICE_REGISTER_ADDR)
+        return;
+
+    memo_target_t &target = memo->targets[target_pc];
+    if(target.impure)
+        return;
+
+    SPAN_BEGIN(begin);
+    const memo_entry_t *entry = memo_lookup<isa_t>(m, &target);
+    SPAN_END(begin, SPAN_RESULT_LOOKUP, entry != 0);
+    //a replayed call must not step over the next interrupt boundary.
+    if(entry && m->instructions + entry->instructions <= limit &&
+       m->instructions + entry->instructions <= m->next_event)
+    {
+        recorders_merge(memo, entry);
+        memo_replay<isa_t>(m, entry, m->reg[7]);
+        ++memo->hits;
+        memo->instructions_skipped += entry->instructions;
+        return;
+    }
+
+    if(memo->recorders.size() >= MEMO_MAX_DEPTH)
+        return;
+
+    memo_recorder_t *r = new memo_recorder_t();
+    r->target = target_pc;
+    r->link = m->reg[7];
+    r->sp = m->reg[6];
+    memcpy(r->entry_reg, m->reg, sizeof(r->entry_reg));
+    r->entry_cc = m->psr & PSR_CC;
+    r->read_mask = 0;
+    r->written_mask = 0;
+    r->cc_read = 0;
+    r->cc_written = 0;
+    r->start_instructions = m->instructions;
+    r->start_cycles = m->cycles;
+    memcpy(r->start_opcode_count, m->opcode_count, sizeof(r->start_opcode_count));
+    memo->recorders.push_back(r);
+}
+
+template<typename isa_t>
+static uint64_t memo_loop(machine_t *m, memo_t *memo, uint64_t max_instructions)
+{
+    uint64_t start = m->instructions;
+    uint64_t limit = start + max_instructions;
+    memo_access_t access;
+
+    while(m->state == MACHINE_RUNNING && m->instructions < limit)
+    {
+        if(m->instructions >= m->next_event)
+        {
+            word_t pc = m->pc;
+            engine_poll<isa_t>(m);
+            if(m->pc != pc)
+                recorder_drop_all(memo);
+            continue;
+        }
+
+        word_t pc = m->pc;
+        if(pc >= DEVICE_REGISTER_ADDR)
+        {
+            recorder_abort_all(memo);
+            engine_step<isa_t>(m);
+            continue;
+        }
+
+        word_t ir = peek<isa_t>(m, pc);
+        bool recording = !memo->recorders.empty();
+        if(recording)
+        {
+            memo_access<isa_t>(m, pc, ir, &access);
+            if(access.impure)
+            {
+                recorder_abort_all(memo);
+                recording = false;
+            }
+            else
+            {
+                for(uint32_t i = 0; i < memo->recorders.size(); )
+                {
+                    memo_recorder_t *r = memo->recorders[i];
+                    recorder_read_regs(r, access.reg_read, access.cc_read);
+                    record_status_t status = RECORD_OK;
+                    for(uint8_t k = 0; k < access.reads && status == RECORD_OK; ++k)
+                        status = recorder_read_mem(r, access.read_addr[k], peek<isa_t>(m, access.read_addr[k]));
+                    if(status == RECORD_OK)
+                        ++i;
+                    else
+                        recorder_abort(memo, i, status == RECORD_IMPURE);
+                }
+            }
+        }
+
+        engine_step<isa_t>(m);
+
+        if(recording)
+        {
+            for(uint32_t i = 0; i < memo->recorders.size(); )
+            {
+                memo_recorder_t *r = memo->recorders[i];
+                r->written_mask |= access.reg_write;
+                r->cc_written |= access.cc_write;
+                record_status_t status = access.writes
+                                       ? recorder_write_mem(r, access.write_addr, peek<isa_t>(m, access.write_addr))
+                                       : RECORD_OK;
+                if(status == RECORD_OK)
+                    ++i;
+                else
+                    recorder_abort(memo, i, status == RECORD_IMPURE);
+            }
+        }
+
+        op_t op = isa_t::opcode_map[ir >> 12];
+        if(op == OP_JSR && m->state == MACHINE_RUNNING)
+            memo_call<isa_t>(m, memo, limit);
+        if(!memo->recorders.empty())
+            memo_returns(m, memo, op == OP_JMP);
+    }
+    return m->instructions - start;
+}
+
+void memo_init(memo_t *memo)
+{
+    memo->targets.clear();
+    memo->recorders.clear();
+    memo->calls = 0;
+    memo->hits = 0;
+    memo->recorded = 0;
+    memo->aborted = 0;
+    memo->instructions_skipped = 0;
+}
+
+void memo_destroy(memo_t *memo)
+{
+    for(memo_recorder_t *r : memo->recorders)
+        delete r;
+    memo->recorders.clear();
+    memo->targets.clear();
+}
+
+uint64_t memo_run(machine_t *m, memo_t *memo, uint64_t max_instructions)
+{
+    if(m->isa == ISA_LC3B)
+        return memo_loop<lc3b_isa_t>(m, memo, max_instructions);
+    return memo_loop<lc3_isa_t>(m, memo, max_instructions);
+}
@@ -0,0 +1,89 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include<vector>
+#include<unordered_map>
+
+#include"../type/type.h"
+#include"../engine/machine.h"
+
+//limits of one recorded call.
+#define MEMO_MAX_INPUTS 256
+#define MEMO_MAX_WRITES 256
+#define MEMO_MAX_DEPTH 64
+#define MEMO_MAX_ENTRIES 4096
+//a call may only write the addresses this far below its entry R6.
+#define MEMO_STACK_SPAN 0x0800
+
+struct memo_cell_t
+{
+    word_t addr;
+    word_t value;
+};
+
+/*
+one completed call of a subroutine:
+    key    : registers and CC read before written, memory words read
+             before written, instruction fetches included
+    result : registers and CC written, stack words written,
+             instructions, cycles and opcode profile of the call
+*/
+struct memo_entry_t
+{
+    uint8_t read_mask;
+    uint8_t cc_read;
+    reg_t in_reg[0x8];
+    word_t in_cc;
+    std::vector<memo_cell_t> inputs;
+
+    uint8_t write_mask;
+    uint8_t cc_written;
+    reg_t out_reg[0x8];
+    word_t out_cc;
+    std::vector<memo_cell_t> writes;
+
+    uint64_t instructions;
+    uint64_t cycles;
+    uint32_t opcode_count[16];
+};
+
+struct memo_target_t
+{
+    //a recorded call had a side effect, the target is never recorded again.
+    //a call that only outgrew MEMO_MAX_INPUTS or MEMO_MAX_WRITES is skipped alone.
+    bool impure;
+    std::vector<memo_entry_t> entries;
+    //hash of the masked registers to entry index.
+    std::unordered_multimap<uint64_t, uint32_t> index;
+    //distinct (read_mask, cc_read) pairs of the entries.
+    std::vector<uint16_t> masks;
+};
+
+struct memo_recorder_t;
+
+struct memo_t
+{
+    std::unordered_map<word_t, memo_target_t> targets;
+    std::vector<memo_recorder_t *> recorders;
+
+    uint64_t calls;
+    uint64_t hits;
+    uint64_t recorded;
+    uint64_t aborted;
+    uint64_t instructions_skipped;
+};
+
+void memo_init(memo_t *memo);
+void memo_destroy(memo_t *memo);
+
+/*
+function define:
+    run like machine_run, every JSR and JSRR target is looked up and
+    a matching call is replayed instead of executed, calls that miss are
+    recorded and dropped at the first TRAP, RTI, device access or store
+    outside their stack frame
+    per instruction hooks do not see replayed calls
+*/
+uint64_t memo_run(machine_t *m, memo_t *memo, uint64_t max_instructions);
+
+#endif //MEMO_H
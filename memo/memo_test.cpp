@@ -0,0 +1,66 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"memo.h"
+#include"../test/check.h"
+
+/*
+SUM at x3020 adds the R1 words from x4000 into R0, the main program calls it
+on 300 words, three times on 5 words from one call site, then on 300 words again
+*/
+static const word_t main_code[] =
+{
+    0x220F, 0x481E, 0x1A20, 0x5DA0, 0x1DA3, 0x220B, 0x4819, 0x1DBF, 0x03FC, 0x1C20,
+    0x2205, 0x4814, 0xF025, 0, 0, 0,
+    300, 5
+};
+static const word_t sum_code[] =
+{
+    0x5020, 0x2408, 0x1660, 0x0405, 0x6880, 0x1004, 0x14A1, 0x16FF, 0x03FB, 0xC1C0, 0x4000
+};
+
+static void load(machine_t *m, std::vector<word_t> &mem)
+{
+    machine_init(m, ISA_LC3, mem.data());
+    memcpy(&mem[0x3000], main_code, sizeof(main_code));
+    memcpy(&mem[0x3020], sum_code, sizeof(sum_code));
+    for(word_t i = 0; i < 300; ++i)
+        mem[0x4000 + i] = i + 1;
+}
+
+int main()
+{
+    std::vector<word_t> plain_mem(UINT16_MAX, 0);
+    std::vector<word_t> memo_mem(UINT16_MAX, 0);
+    machine_t *plain = new machine_t();
+    machine_t *m = new machine_t();
+    load(plain, plain_mem);
+    load(m, memo_mem);
+
+    machine_run(plain, 100000);
+    memo_t *memo = new memo_t();
+    memo_init(memo);
+    memo_run(m, memo, 100000);
+
+    CHECK(plain->state == MACHINE_HALTED && m->state == MACHINE_HALTED);
+    CHECK(plain->reg[5] == (word_t)45150 && plain->reg[6] == 15);
+    CHECK(!memcmp(plain->reg, m->reg, sizeof(m->reg)));
+    CHECK(plain->psr == m->psr && plain->pc == m->pc);
+    CHECK(plain->instructions == m->instructions && plain->cycles == m->cycles);
+    CHECK(!memcmp(plain->opcode_count, m->opcode_count, sizeof(m->opcode_count)));
+
+    //the 300 word calls outgrow MEMO_MAX_INPUTS, the 5 word calls are still
+    //recorded, the third one with the R0 and R7 of the second is replayed.
+    CHECK(memo->calls == 5);
+    CHECK(memo->aborted == 2);
+    CHECK(memo->recorded == 2 && memo->hits == 1);
+    CHECK(!memo->targets[0x3020].impure);
+    CHECK(memo->instructions_skipped > 0);
+
+    memo_destroy(memo);
+    delete memo;
+    delete plain;
+    delete m;
+    return check_result();
+}
@@ -0,0 +1,369 @@
+#include<stdio.h>
+#include<string.h>
+#include<unistd.h>
+
+#include"park.h"
+#include"../probe/probe.h"
+#include"../profile/span.h"
+
+#define PARK_MAGIC 0x4B524150
+
+//match token: 1, len - 2 in 7 bits, offset - 1 in 8 bits.
+//literal token: 0, count in 15 bits, then count words.
+#define LZ_MATCH 0x8000
+#define LZ_MIN_MATCH 2
+#define LZ_MAX_MATCH 129
+#define LZ_MAX_OFFSET 256
+#define LZ_MAX_LITERALS 0x7FFF
+
+static uint32_t park_page_words(uint32_t p)
+{
+    uint32_t begin = p * PAGE_WORDS;
+    return MEM_WORDS - begin < PAGE_WORDS ? MEM_WORDS - begin : PAGE_WORDS;
+}
+
+static bool lz_literals(const word_t *page, uint32_t begin, uint32_t end,
+                        word_t *out, uint32_t *len, uint32_t limit)
+{
+    if(begin == end)
+        return true;
+    if(*len + 1 + (end - begin) >= limit)
+        return false;
+    out[(*len)++] = (word_t)(end - begin);
+    memcpy(out + *len, page + begin, (end - begin) * sizeof(word_t));
+    *len += end - begin;
+    return true;
+}
+
+uint32_t park_compress_page(const word_t *page, uint32_t words, word_t *out)
+{
+    //last position + 1 of every hashed word pair.
+    uint16_t head[0x100];
+    memset(head, 0, sizeof(head));
+
+    uint32_t len = 0;
+    uint32_t literal = 0;
+    uint32_t i = 0;
+    while(i < words)
+    {
+        uint32_t match = 0;
+        uint32_t offset = 0;
+        if(i + 1 < words)
+        {
+            uint32_t h = ((page[i] * 0x9E37u) ^ (page[i + 1] * 0x79B9u)) >> 8 & 0xFF;
+            uint32_t candidate = head[h];
+            head[h] = (uint16_t)(i + 1);
+            if(candidate && i - (candidate - 1) <= LZ_MAX_OFFSET)
+            {
+                uint32_t from = candidate - 1;
+                while(i + match < words && match < LZ_MAX_MATCH && page[from + match] == page[i + match])
+                    ++match;
+                offset = i - from;
+            }
+        }
+
+        //a page never holds LZ_MAX_LITERALS words, one literal token covers any run.
+        if(match < LZ_MIN_MATCH)
+        {
+            ++i;
+            continue;
+        }
+
+        if(!lz_literals(page, literal, i, out, &len, words) || len + 1 >= words)
+            return 0;
+        out[len++] = (word_t)(LZ_MATCH | ((match - LZ_MIN_MATCH) << 8) | (offset - 1));
+        i += match;
+        literal = i;
+    }
+    if(!lz_literals(page, literal, words, out, &len, words))
+        return 0;
+    return len;
+}
+
+bool park_decompress_page(const word_t *in, uint32_t in_words, word_t *page, uint32_t words)
+{
+    uint32_t pos = 0;
+    uint32_t i = 0;
+    while(i < in_words)
+    {
+        word_t token = in[i++];
+        if(token & LZ_MATCH)
+        {
+            uint32_t match = ((token >> 8) & 0x7F) + LZ_MIN_MATCH;
+            uint32_t offset = (token & 0xFF) + 1;
+            if(offset > pos || pos + match > words)
+                return false;
+            //forward copy, an overlapping match repeats the run.
+            for(uint32_t k = 0; k < match; ++k, ++pos)
+                page[pos] = page[pos - offset];
+        }
+        else
+        {
+            if(i + token > in_words || pos + token > words)
+                return false;
+            memcpy(page + pos, in + i, token * sizeof(word_t));
+            i += token;
+            pos += token;
+        }
+    }
+    return pos == words;
+}
+
+void park_init(park_t *park, uint64_t idle_timeout_ns, uint64_t memory_budget, const char *swap_dir)
+{
+    park->idle_timeout_ns = idle_timeout_ns;
+    park->memory_budget = memory_budget;
+    park->swap_dir[0] = 0;
+    if(swap_dir)
+    {
+        strncpy(park->swap_dir, swap_dir, sizeof(park->swap_dir) - 1);
+        park->swap_dir[sizeof(park->swap_dir) - 1] = 0;
+    }
+    park->wake_budget_ns = 1000000;
+    park->machines.clear();
+    park->resident_bytes = 0;
+    park->compressed_bytes = 0;
+    park->compressed = 0;
+    park->swapped = 0;
+    park->wakes = 0;
+    park->wake_total_ns = 0;
+    park->wake_max_ns = 0;
+    park->wake_over_budget = 0;
+    memset(park->wake_latency, 0, sizeof(park->wake_latency));
+}
+
+static void swap_path(const park_t *park, uint32_t id, char *path, uint32_t size)
+{
+    snprintf(path, size, "%s/machine-%u.park", park->swap_dir, id);
+}
+
+void park_destroy(park_t *park)
+{
+    for(uint32_t id = 0; id < park->machines.size(); ++id)
+    {
+        parked_machine_t *pm = park->machines[id];
+        if(pm->state == PARK_SWAPPED)
+        {
+            char path[300];
+            swap_path(park, id, path, sizeof(path));
+            unlink(path);
+        }
+        //the machine keeps no pointer into the park.
+        delete[] pm->m->mem;
+        pm->m->mem = 0;
+        delete pm;
+    }
+    park->machines.clear();
+}
+
+uint32_t park_attach(park_t *park, machine_t *m)
+{
+    parked_machine_t *pm = new parked_machine_t();
+    //an LC-3b mem is shorter, the pages past it are kept as zero.
+    uint32_t mem_words = m->isa == ISA_LC3B ? lc3b_isa_t::mem_words : lc3_isa_t::mem_words;
+    word_t *mem = new word_t[MEM_WORDS];
+    memcpy(mem, m->mem, mem_words * sizeof(word_t));
+    memset(mem + mem_words, 0, (MEM_WORDS - mem_words) * sizeof(word_t));
+    m->mem = mem;
+
+    pm->m = m;
+    pm->state = PARK_RESIDENT;
+    pm->last_active = monotonic_ns();
+    park->resident_bytes += MEM_WORDS * sizeof(word_t);
+    park->machines.push_back(pm);
+    return (uint32_t)park->machines.size() - 1;
+}
+
+static void park_compress(park_t *park, parked_machine_t *pm)
+{
+    word_t scratch[PAGE_WORDS];
+    const word_t *mem = pm->m->mem;
+    pm->blob.clear();
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        const word_t *page = mem + p * PAGE_WORDS;
+        uint32_t words = park_page_words(p);
+        pm->offset[p] = (uint32_t)pm->blob.size();
+
+        bool zero = true;
+        for(uint32_t i = 0; i < words && zero; ++i)
+            zero = page[i] == 0;
+        if(zero)
+        {
+            pm->kind[p] = PARK_PAGE_ZERO;
+            pm->length[p] = 0;
+            continue;
+        }
+
+        uint32_t len = park_compress_page(page, words, scratch);
+        if(len)
+        {
+            pm->kind[p] = PARK_PAGE_LZ;
+            pm->blob.insert(pm->blob.end(), scratch, scratch + len);
+        }
+        else
+        {
+            pm->kind[p] = PARK_PAGE_RAW;
+            len = words;
+            pm->blob.insert(pm->blob.end(), page, page + words);
+        }
+        pm->length[p] = (uint16_t)len;
+    }
+    pm->blob.shrink_to_fit();
+
+    delete[] pm->m->mem;
+    pm->m->mem = 0;
+    pm->state = PARK_COMPRESSED;
+    park->resident_bytes -= MEM_WORDS * sizeof(word_t);
+    park->compressed_bytes += pm->blob.size() * sizeof(word_t);
+    ++park->compressed;
+}
+
+static bool park_swap_out(park_t *park, uint32_t id)
+{
+    parked_machine_t *pm = park->machines[id];
+    char path[300];
+    swap_path(park, id, path, sizeof(path));
+    FILE *out = fopen(path, "wb");
+    if(!out)
+        return false;
+
+    uint32_t header[2] = {PARK_MAGIC, (uint32_t)pm->blob.size()};
+    bool ok = fwrite(header, sizeof(header), 1, out) == 1 &&
+              (pm->blob.empty() || fwrite(pm->blob.data(), pm->blob.size() * sizeof(word_t), 1, out) == 1);
+    ok = fclose(out) == 0 && ok;
+    if(!ok)
+    {
+        unlink(path);
+        return false;
+    }
+
+    //page tables stay in memory, only the blob goes to the file.
+    park->compressed_bytes -= pm->blob.size() * sizeof(word_t);
+    std::vector<word_t>().swap(pm->blob);
+    pm->state = PARK_SWAPPED;
+    ++park->swapped;
+    return true;
+}
+
+static bool park_swap_in(park_t *park, uint32_t id)
+{
+    parked_machine_t *pm = park->machines[id];
+    char path[300];
+    swap_path(park, id, path, sizeof(path));
+    FILE *in = fopen(path, "rb");
+    if(!in)
+        return false;
+
+    uint32_t header[2];
+    bool ok = fread(header, sizeof(header), 1, in) == 1 && header[0] == PARK_MAGIC;
+    if(ok)
+    {
+        pm->blob.resize(header[1]);
+        ok = pm->blob.empty() || fread(pm->blob.data(), pm->blob.size() * sizeof(word_t), 1, in) == 1;
+    }
+    fclose(in);
+    if(!ok)
+        return false;
+
+    unlink(path);
+    pm->state = PARK_COMPRESSED;
+    park->compressed_bytes += pm->blob.size() * sizeof(word_t);
+    return true;
+}
+
+bool park_wake(park_t *park, uint32_t id)
+{
+    parked_machine_t *pm = park->machines[id];
+    if(pm->state == PARK_RESIDENT)
+        return true;
+
+    uint64_t begin = monotonic_ns();
+    if(pm->state == PARK_SWAPPED && !park_swap_in(park, id))
+        return false;
+
+    word_t *mem = new word_t[MEM_WORDS];
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        word_t *page = mem + p * PAGE_WORDS;
+        uint32_t words = park_page_words(p);
+        const word_t *data = pm->blob.data() + pm->offset[p];
+        bool ok = true;
+        if(pm->kind[p] == PARK_PAGE_ZERO)
+            memset(page, 0, words * sizeof(word_t));
+        else if(pm->kind[p] == PARK_PAGE_RAW)
+            memcpy(page, data, words * sizeof(word_t));
+        else
+            ok = park_decompress_page(data, pm->length[p], page, words);
+        if(!ok)
+        {
+            delete[] mem;
+            return false;
+        }
+    }
+
+    park->compressed_bytes -= pm->blob.size() * sizeof(word_t);
+    std::vector<word_t>().swap(pm->blob);
+    pm->m->mem = mem;
+    pm->state = PARK_RESIDENT;
+    park->resident_bytes += MEM_WORDS * sizeof(word_t);
+
+    uint64_t latency = monotonic_ns() - begin;
+    ++park->wakes;
+    park->wake_total_ns += latency;
+    park->wake_max_ns = latency > park->wake_max_ns ? latency : park->wake_max_ns;
+    if(latency > park->wake_budget_ns)
+        ++park->wake_over_budget;
+    uint32_t bucket = 0;
+    for(uint64_t us = latency / 1000; us && bucket + 1 < PARK_LATENCY_BUCKETS; us >>= 1)
+        ++bucket;
+    ++park->wake_latency[bucket];
+    PROBE2(park_wake, id, latency);
+    return true;
+}
+
+bool park_set_input(park_t *park, uint32_t id, const uint8_t *input, uint32_t len)
+{
+    if(!park_wake(park, id))
+        return false;
+    parked_machine_t *pm = park->machines[id];
+    machine_set_input(pm->m, input, len);
+    pm->last_active = monotonic_ns();
+    return true;
+}
+
+uint64_t park_run(park_t *park, uint32_t id, uint64_t max_instructions)
+{
+    if(!park_wake(park, id))
+        return 0;
+    parked_machine_t *pm = park->machines[id];
+    uint64_t executed = machine_run(pm->m, max_instructions);
+    pm->last_active = monotonic_ns();
+    return executed;
+}
+
+void park_tick(park_t *park, uint64_t now_ns)
+{
+    for(parked_machine_t *pm : park->machines)
+    {
+        if(pm->state == PARK_RESIDENT && pm->m->state == MACHINE_BLOCKED &&
+           now_ns - pm->last_active >= park->idle_timeout_ns)
+            park_compress(park, pm);
+    }
+
+    if(!park->swap_dir[0])
+        return;
+    while(park->resident_bytes + park->compressed_bytes > park->memory_budget)
+    {
+        uint32_t victim = UINT32_MAX;
+        for(uint32_t id = 0; id < park->machines.size(); ++id)
+        {
+            parked_machine_t *pm = park->machines[id];
+            if(pm->state == PARK_COMPRESSED &&
+               (victim == UINT32_MAX || pm->last_active < park->machines[victim]->last_active))
+                victim = id;
+        }
+        if(victim == UINT32_MAX || !park_swap_out(park, victim))
+            break;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef PARK_H
+#define PARK_H
+
+#include<vector>
+
+#include"../type/type.h"
+#include"../engine/machine.h"
+#include"../snapshot/page_store.h"
+
+//how a page of a parked machine is kept.
+#define PARK_PAGE_ZERO 0
+#define PARK_PAGE_RAW 1
+#define PARK_PAGE_LZ 2
+
+//wake latency histogram, bucket b counts wakes under 2^b microseconds.
+#define PARK_LATENCY_BUCKETS 20
+
+enum park_state_t
+{
+    PARK_RESIDENT,
+    //pages compressed in memory, mem freed.
+    PARK_COMPRESSED,
+    //compressed pages written to a file under swap_dir.
+    PARK_SWAPPED
+};
+
+struct parked_machine_t
+{
+    machine_t *m;
+    park_state_t state;
+    uint64_t last_active;
+
+    //compressed pages, page p is length[p] words at offset[p] of blob.
+    std::vector<word_t> blob;
+    uint32_t offset[PAGE_COUNT];
+    uint16_t length[PAGE_COUNT];
+    uint8_t kind[PAGE_COUNT];
+};
+
+struct park_t
+{
+    //a machine blocked on input this long is compressed.
+    uint64_t idle_timeout_ns;
+    //resident and compressed bytes above which compressed machines are swapped out.
+    uint64_t memory_budget;
+    char swap_dir[256];
+    //wakes slower than this count as over budget.
+    uint64_t wake_budget_ns;
+
+    std::vector<parked_machine_t *> machines;
+
+    uint64_t resident_bytes;
+    uint64_t compressed_bytes;
+    uint32_t compressed;
+    uint32_t swapped;
+
+    uint64_t wakes;
+    uint64_t wake_total_ns;
+    uint64_t wake_max_ns;
+    uint64_t wake_over_budget;
+    uint64_t wake_latency[PARK_LATENCY_BUCKETS];
+};
+
+void park_init(park_t *park, uint64_t idle_timeout_ns, uint64_t memory_budget, const char *swap_dir);
+void park_destroy(park_t *park);
+
+//the park takes over m->mem, it holds a copy from now on and m->mem points at it.
+uint32_t park_attach(park_t *park, machine_t *m);
+
+/*
+function define:
+    make the memory of machine id resident again, reading its swap file
+    and decompressing its pages, the wake latency is recorded
+    return false when the swap file cannot be read back
+*/
+bool park_wake(park_t *park, uint32_t id);
+
+//wake machine id, hand it input and run it, it stays active until it blocks again.
+bool park_set_input(park_t *park, uint32_t id, const uint8_t *input, uint32_t len);
+uint64_t park_run(park_t *park, uint32_t id, uint64_t max_instructions);
+
+/*
+function define:
+    compress the machines blocked on input for idle_timeout_ns,
+    then swap out compressed machines, least recently active first,
+    while the park holds more than memory_budget bytes
+*/
+void park_tick(park_t *park, uint64_t now_ns);
+
+//LZ coding of one page into out, which holds words words.
+//return the coded length, 0 when the page does not get smaller.
+uint32_t park_compress_page(const word_t *page, uint32_t words, word_t *out);
+bool park_decompress_page(const word_t *in, uint32_t in_words, word_t *page, uint32_t words);
+
+#endif //PARK_H
@@ -0,0 +1,64 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"park.h"
+#include"../profile/span.h"
+#include"../test/check.h"
+
+//GETC; OUT; HALT at x3000.
+static const uint8_t program[] = {0x30, 0x00, 0xF0, 0x20, 0xF0, 0x21, 0xF0, 0x25};
+
+int main()
+{
+    //mem sized for each variant, attach must not read past the LC-3b one.
+    std::vector<word_t> mem(lc3_isa_t::mem_words, 0);
+    std::vector<word_t> mem_b(lc3b_isa_t::mem_words, 0);
+    mem_b[lc3b_isa_t::mem_words - 1] = 0x5A5A;
+    machine_t *m = new machine_t();
+    machine_t *b = new machine_t();
+    machine_init(m, ISA_LC3, mem.data());
+    machine_init(b, ISA_LC3B, mem_b.data());
+    machine_load_obj(m, program, sizeof(program));
+    machine_load_obj(b, program, sizeof(program));
+
+    park_t *park = new park_t();
+    park_init(park, 0, UINT64_MAX, 0);
+    uint32_t id = park_attach(park, m);
+    uint32_t id_b = park_attach(park, b);
+    CHECK(m->mem != mem.data() && b->mem != mem_b.data());
+    CHECK(b->mem[lc3b_isa_t::mem_words - 1] == 0x5A5A && b->mem[lc3b_isa_t::mem_words] == 0);
+    CHECK(b->mem[MEM_WORDS - 1] == 0);
+    std::vector<word_t> expect_b(b->mem, b->mem + MEM_WORDS);
+
+    park_run(park, id, 100);
+    park_run(park, id_b, 100);
+    CHECK(m->state == MACHINE_BLOCKED && b->state == MACHINE_BLOCKED);
+
+    //both are blocked on GETC, a tick compresses them.
+    park_tick(park, monotonic_ns() + 1);
+    CHECK(park->compressed == 2 && !m->mem && !b->mem);
+
+    CHECK(park_set_input(park, id_b, (const uint8_t *)"q", 1));
+    CHECK(!memcmp(b->mem, expect_b.data(), MEM_WORDS * sizeof(word_t)));
+    park_run(park, id_b, 100);
+    CHECK(b->state == MACHINE_HALTED && !b->output.empty() && b->output[0] == 'q');
+    CHECK(park->wakes == 1);
+
+    //a page that compresses comes back as it was.
+    word_t page[PAGE_WORDS];
+    word_t coded[PAGE_WORDS];
+    word_t back[PAGE_WORDS];
+    for(uint32_t i = 0; i < PAGE_WORDS; ++i)
+        page[i] = (word_t)(i % 7 == 0 ? 0x1234 : i & 0x0F);
+    uint32_t len = park_compress_page(page, PAGE_WORDS, coded);
+    CHECK(len > 0 && len < PAGE_WORDS);
+    CHECK(park_decompress_page(coded, len, back, PAGE_WORDS));
+    CHECK(!memcmp(page, back, sizeof(page)));
+
+    park_destroy(park);
+    delete park;
+    delete m;
+    delete b;
+    return check_result();
+}
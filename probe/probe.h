@@ -0,0 +1,39 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+/*
+static tracepoints, provider lc3sim:
+    fetch(pc, ir)                    an instruction is fetched, state 18
+    trap(vector, pc)                 a TRAP enters its routine or the native service
+    interrupt(vector, priority, pc)  an interrupt or exception is taken
+    decode_page(page, published)     a page is mapped into a decode cache
+    translate(page, blocks)          a page is decoded and split into blocks,
+                                     blocks is 1 when a write decodes one word again
+    snapshot_take(id)
+    snapshot_restore(id)
+    job_start(job, input_len)        the first run of a job, with prefix sharing
+                                     the jobs of a group start with its first run
+    job_end(job, state, instructions)
+    park_wake(machine, latency_ns)
+with <sys/sdt.h> a probe is a NOP plus a .note.stapsdt entry for bpftrace
+and perf to patch, without it or with PROBE_DISABLE only the arguments are evaluated
+*/
+
+#if !defined(PROBE_DISABLE) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include<sys/sdt.h>
+#define PROBE_SDT 1
+#endif
+#endif
+
+#ifdef PROBE_SDT
+#define PROBE1(name, a) DTRACE_PROBE1(lc3sim, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(lc3sim, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(lc3sim, name, a, b, c)
+#else
+#define PROBE1(name, a) do { (void)(a); } while(0)
+#define PROBE2(name, a, b) do { (void)(a); (void)(b); } while(0)
+#define PROBE3(name, a, b, c) do { (void)(a); (void)(b); (void)(c); } while(0)
+#endif
+
+#endif //PROBE_H
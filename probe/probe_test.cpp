@@ -0,0 +1,47 @@
+#include<stdint.h>
+
+#include"probe.h"
+#include"../test/check.h"
+
+//built three ways: against the stub header, with PROBE_DISABLE and against systemtap's header when found.
+#ifdef PROBE_DISABLE
+#ifdef PROBE_SDT
+#error PROBE_DISABLE left the probes in
+#endif
+#elif !defined(PROBE_SDT)
+#error <sys/sdt.h> is not on the include path
+#endif
+
+#ifdef SDT_STUB_H
+int sdt_fired = 0;
+unsigned long long sdt_args[3];
+#endif
+
+static int evaluated = 0;
+
+static uint32_t arg(uint32_t value)
+{
+    ++evaluated;
+    return value;
+}
+
+int main()
+{
+    //every argument is evaluated exactly once, whichever branch expanded the probe.
+    PROBE1(snapshot_take, arg(7));
+    PROBE2(translate, arg(0x30), arg(2));
+    PROBE3(job_end, arg(1), arg(2), (uint64_t)arg(3) << 40);
+    CHECK(evaluated == 6);
+
+    //a probe is a single statement.
+    if(evaluated)
+        PROBE1(snapshot_restore, 1);
+    else
+        CHECK(false);
+
+#ifdef SDT_STUB_H
+    CHECK(sdt_fired == 4);
+    CHECK(sdt_args[0] == 1 && sdt_args[1] == 2 && sdt_args[2] == 3ULL << 40);
+#endif
+    return check_result();
+}
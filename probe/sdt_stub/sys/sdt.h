@@ -0,0 +1,16 @@
+#ifndef SDT_STUB_H
+#define SDT_STUB_H
+
+//stands in for systemtap's <sys/sdt.h> so probe_test builds and runs the PROBE_SDT branch without it,
+//a fired probe is counted and its arguments kept.
+extern int sdt_fired;
+extern unsigned long long sdt_args[3];
+
+#define DTRACE_PROBE1(provider, name, a) \
+    do { ++sdt_fired; sdt_args[0] = (a); } while(0)
+#define DTRACE_PROBE2(provider, name, a, b) \
+    do { ++sdt_fired; sdt_args[0] = (a); sdt_args[1] = (b); } while(0)
+#define DTRACE_PROBE3(provider, name, a, b, c) \
+    do { ++sdt_fired; sdt_args[0] = (a); sdt_args[1] = (b); sdt_args[2] = (c); } while(0)
+
+#endif //SDT_STUB_H
@@ -0,0 +1,165 @@
+#include<string.h>
+
+#include"interval.h"
+
+static const char *op_name[OP_COUNT] =
+{
+    "BR", "ADD", "LD", "ST", "JSR", "AND", "LDR", "STR",
+    "RTI", "NOT", "LDI", "STI", "JMP", "LEA", "TRAP",
+    "LDB", "STB", "LDW", "STW", "XOR", "SHF", "RESERVED"
+};
+
+static void interval_reset(interval_stats_t *s, uint64_t instructions, uint64_t cycles)
+{
+    s->remaining = s->length;
+    s->start_instruction = instructions;
+    s->start_cycles = cycles;
+    memset(s->opcode_mix, 0, sizeof(s->opcode_mix));
+    s->mem_accesses = 0;
+    s->branches = 0;
+    memset(s->bbv, 0, sizeof(s->bbv));
+}
+
+bool interval_init(interval_stats_t *s, uint32_t length, uint32_t max_phases, word_t pc)
+{
+    //remaining would wrap at 0, and phase_classify needs one phase to fall back to.
+    if(length == 0 || max_phases == 0)
+        return false;
+
+    s->length = length;
+    s->threshold = 0.5f;
+    s->max_phases = max_phases;
+    s->samples_per_phase = 1;
+    s->block_len = 0;
+    s->block_pc = pc;
+    s->records.clear();
+    s->phases.clear();
+    s->on_interval = 0;
+    s->ctx = 0;
+    interval_reset(s, 0, 0);
+    return true;
+}
+
+static float bbv_distance(const float *a, const float *b)
+{
+    float d = 0;
+    for(int i = 0; i < BBV_DIM; ++i)
+    {
+        d += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+    return d;
+}
+
+/*
+function define:
+    leader-follower clustering, join the nearest phase within threshold
+    and move its centroid, otherwise open a new phase
+*/
+static uint32_t phase_classify(interval_stats_t *s, const float *bbv)
+{
+    uint32_t best = 0;
+    float best_distance = 3.0f;
+    for(uint32_t i = 0; i < s->phases.size(); ++i)
+    {
+        float d = bbv_distance(s->phases[i].centroid, bbv);
+        if(d < best_distance)
+        {
+            best = i;
+            best_distance = d;
+        }
+    }
+
+    if(best_distance > s->threshold && s->phases.size() < s->max_phases)
+    {
+        phase_t phase;
+        memcpy(phase.centroid, bbv, sizeof(phase.centroid));
+        phase.intervals = 1;
+        phase.samples = 0;
+        s->phases.push_back(phase);
+        return (uint32_t)s->phases.size() - 1;
+    }
+
+    phase_t &phase = s->phases[best];
+    ++phase.intervals;
+    for(int i = 0; i < BBV_DIM; ++i)
+    {
+        phase.centroid[i] += (bbv[i] - phase.centroid[i]) / phase.intervals;
+    }
+    return best;
+}
+
+void interval_close(interval_stats_t *s, uint64_t instructions, uint64_t cycles)
+{
+    //the open basic block counts toward the interval it ran in.
+    if(s->block_len)
+    {
+        s->bbv[BBV_BUCKET(s->block_pc)] += s->block_len;
+        s->block_len = 0;
+    }
+
+    interval_record_t record;
+    record.index = s->records.size();
+    record.first_instruction = s->start_instruction;
+    record.instructions = instructions - s->start_instruction;
+    record.cycles = cycles - s->start_cycles;
+    if(record.instructions == 0)
+        return;
+
+    memcpy(record.opcode_mix, s->opcode_mix, sizeof(record.opcode_mix));
+    record.mem_accesses = s->mem_accesses;
+    record.branches = s->branches;
+
+    uint64_t total = 0;
+    for(int i = 0; i < BBV_DIM; ++i)
+        total += s->bbv[i];
+    for(int i = 0; i < BBV_DIM; ++i)
+        record.bbv[i] = total ? (float)s->bbv[i] / total : 0.0f;
+
+    record.phase = phase_classify(s, record.bbv);
+    record.phase_change = s->records.empty() || s->records.back().phase != record.phase;
+    phase_t &phase = s->phases[record.phase];
+    record.sample = phase.samples < s->samples_per_phase;
+    if(record.sample)
+        ++phase.samples;
+
+    s->records.push_back(record);
+    if(s->on_interval)
+        s->on_interval(s, &s->records.back(), s->ctx);
+
+    interval_reset(s, instructions, cycles);
+}
+
+bool interval_should_sample(const interval_stats_t *s)
+{
+    //the next interval is predicted to stay in the last phase.
+    if(s->records.empty())
+        return true;
+    const interval_record_t &last = s->records.back();
+    return last.phase_change || s->phases[last.phase].samples < s->samples_per_phase;
+}
+
+void interval_write_csv(const interval_stats_t *s, FILE *out)
+{
+    fprintf(out, "interval,first_instruction,instructions,cycles,ipc,cpi,mem_rate,branch_rate,phase,phase_change,sample");
+    for(int op = 0; op < OP_COUNT; ++op)
+        fprintf(out, ",%s", op_name[op]);
+    for(int i = 0; i < BBV_DIM; ++i)
+        fprintf(out, ",bbv%d", i);
+    fprintf(out, "\n");
+
+    for(const interval_record_t &r : s->records)
+    {
+        double n = (double)r.instructions;
+        double cycles = r.cycles ? (double)r.cycles : 1.0;
+        fprintf(out, "%llu,%llu,%llu,%llu,%.4f,%.4f,%.4f,%.4f,%u,%u,%u",
+                (unsigned long long)r.index, (unsigned long long)r.first_instruction,
+                (unsigned long long)r.instructions, (unsigned long long)r.cycles,
+                n / cycles, cycles / n, r.mem_accesses / n, r.branches / n,
+                r.phase, r.phase_change, r.sample);
+        for(int op = 0; op < OP_COUNT; ++op)
+            fprintf(out, ",%.4f", r.opcode_mix[op] / n);
+        for(int i = 0; i < BBV_DIM; ++i)
+            fprintf(out, ",%.4f", r.bbv[i]);
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include<stdio.h>
+#include<vector>
+
+#include"../type/type.h"
+#include"../engine/isa.h"
+
+//buckets of the basic block vector signature.
+#define BBV_DIM 32
+#define BBV_BUCKET(pc) (uint32_t)((((pc) * 0x9E37u) >> 8) & (BBV_DIM - 1))
+
+//data memory accesses per operation class, instruction fetch excluded.
+static const uint8_t op_mem_accesses[OP_COUNT] =
+{
+    0, 0, 1, 1,   //BR ADD LD ST
+    0, 0, 1, 1,   //JSR AND LDR STR
+    2, 0, 2, 2,   //RTI NOT LDI STI
+    0, 0, 1,      //JMP LEA TRAP
+    1, 1, 1, 1,   //LDB STB LDW STW
+    0, 0, 0       //XOR SHF RESERVED
+};
+
+//operation classes that end a basic block.
+static const uint8_t op_ends_block[OP_COUNT] =
+{
+    1, 0, 0, 0,
+    1, 0, 0, 0,
+    1, 0, 0, 0,
+    1, 0, 1,
+    0, 0, 0, 0,
+    0, 0, 1
+};
+
+//statistics of one closed interval.
+struct interval_record_t
+{
+    uint64_t index;
+    uint64_t first_instruction;
+    uint64_t instructions;
+    uint64_t cycles;
+    uint32_t opcode_mix[OP_COUNT];
+    uint32_t mem_accesses;
+    uint32_t branches;
+    //instructions per bucket, normalised to sum 1.
+    float bbv[BBV_DIM];
+    uint32_t phase;
+    uint8_t phase_change;
+    //the sampling policy asks for detailed simulation of this interval.
+    uint8_t sample;
+};
+
+struct phase_t
+{
+    float centroid[BBV_DIM];
+    uint32_t intervals;
+    uint32_t samples;
+};
+
+struct interval_stats_t;
+typedef void (*interval_fn_t)(const interval_stats_t *s, const interval_record_t *record, void *ctx);
+
+struct interval_stats_t
+{
+    //N, instructions per interval.
+    uint32_t length;
+    //manhattan distance between signatures below which intervals share a phase.
+    float threshold;
+    uint32_t max_phases;
+    //intervals of each phase marked for sampling.
+    uint32_t samples_per_phase;
+
+    //counters of the open interval.
+    uint32_t remaining;
+    uint64_t start_instruction;
+    uint64_t start_cycles;
+    uint32_t opcode_mix[OP_COUNT];
+    uint32_t mem_accesses;
+    uint32_t branches;
+    uint32_t bbv[BBV_DIM];
+    uint32_t block_len;
+    word_t block_pc;
+
+    std::vector<interval_record_t> records;
+    std::vector<phase_t> phases;
+
+    interval_fn_t on_interval;
+    void *ctx;
+};
+
+//return false for a length or max_phases of 0, s is then left untouched.
+bool interval_init(interval_stats_t *s, uint32_t length, uint32_t max_phases, word_t pc);
+
+//close the open interval, classify it and report it.
+void interval_close(interval_stats_t *s, uint64_t instructions, uint64_t cycles);
+
+//a few counter increments per retired instruction.
+inline void interval_record(interval_stats_t *s, op_t op, word_t next_pc,
+                            uint64_t instructions, uint64_t cycles)
+{
+    ++s->opcode_mix[op];
+    s->mem_accesses += op_mem_accesses[op];
+    ++s->block_len;
+    if(op_ends_block[op])
+    {
+        ++s->branches;
+        s->bbv[BBV_BUCKET(s->block_pc)] += s->block_len;
+        s->block_len = 0;
+        s->block_pc = next_pc;
+    }
+    if(--s->remaining == 0)
+        interval_close(s, instructions, cycles);
+}
+
+//true when the intervals of the current phase still need a detailed sample.
+bool interval_should_sample(const interval_stats_t *s);
+
+void interval_write_csv(const interval_stats_t *s, FILE *out);
+
+#endif //INTERVAL_H
@@ -0,0 +1,41 @@
+#include<stdio.h>
+
+#include"interval.h"
+#include"../test/check.h"
+
+int main()
+{
+    interval_stats_t s;
+    CHECK(!interval_init(&s, 0, 16, 0x3000));
+    CHECK(!interval_init(&s, 8, 0, 0x3000));
+    CHECK(interval_init(&s, 8, 2, 0x3000));
+
+    //three loops far apart in the signature, one interval each, twice over.
+    const word_t loop_pc[3] = {0x3000, 0x4100, 0x5200};
+    uint64_t instructions = 0;
+    for(int round = 0; round < 2; ++round)
+    {
+        for(int l = 0; l < 3; ++l)
+        {
+            for(int i = 0; i < 8; ++i)
+            {
+                ++instructions;
+                op_t op = (i & 3) == 3 ? OP_BR : OP_ADD;
+                interval_record(&s, op, loop_pc[l], instructions, instructions * 2);
+            }
+        }
+    }
+
+    CHECK(s.records.size() == 6);
+    //the third loop joins one of the two phases allowed.
+    CHECK(s.phases.size() == 2);
+    for(size_t r = 0; r < s.records.size(); ++r)
+    {
+        CHECK(s.records[r].instructions == 8 && s.records[r].cycles == 16);
+        CHECK(s.records[r].phase < 2);
+        CHECK(s.records[r].branches == 2 && s.records[r].opcode_mix[OP_ADD] == 6);
+    }
+    CHECK(s.records[0].phase_change && s.records[1].phase_change);
+
+    return check_result();
+}
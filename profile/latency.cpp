@@ -0,0 +1,57 @@
+#include<string.h>
+
+#include"latency.h"
+
+static const char *latency_source_name[LATENCY_SOURCES] =
+{
+    "privilege", "illegal", "keyboard", "timer"
+};
+
+static const char *latency_phase_name[LATENCY_PHASES] =
+{
+    "pending", "dispatch", "handler", "total"
+};
+
+void latency_init(latency_stats_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    for(int i = 0; i < LATENCY_SOURCES; ++i)
+        s->raised[i] = LATENCY_NONE;
+}
+
+static void latency_write_row(const char *name, const latency_histogram_t *h, FILE *out)
+{
+    for(int phase = 0; phase < LATENCY_PHASES; ++phase)
+    {
+        const latency_histogram_t *x = &h[phase];
+        if(!x->count)
+            continue;
+        fprintf(out, "%-10s %-9s %10llu %12.1f %10llu  ", name, latency_phase_name[phase],
+                (unsigned long long)x->count, (double)x->total / x->count,
+                (unsigned long long)x->max);
+        //<2^b:count for every nonempty bucket.
+        for(int b = 0; b < LATENCY_BUCKETS; ++b)
+        {
+            if(x->bucket[b])
+                fprintf(out, " <%llu:%llu", 1ull << b, (unsigned long long)x->bucket[b]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+void latency_write(const latency_stats_t *s, FILE *out)
+{
+    fprintf(out, "%-10s %-9s %10s %12s %10s  buckets\n", "source", "phase", "count", "mean", "max");
+    for(int i = 0; i < LATENCY_SOURCES; ++i)
+        latency_write_row(latency_source_name[i], s->device[i], out);
+
+    char name[16];
+    for(int p = 0; p < 8; ++p)
+    {
+        snprintf(name, sizeof(name), "priority%d", p);
+        latency_write_row(name, s->priority[p], out);
+    }
+    if(s->overflow || s->unmatched)
+        fprintf(out, "overflow %llu unmatched %llu\n",
+                (unsigned long long)s->overflow, (unsigned long long)s->unmatched);
+}
@@ -0,0 +1,203 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include<stdio.h>
+
+#include"../type/type.h"
+#include"../engine/machine.h"
+
+/*
+interrupt and exception latency in cycles, four timestamps per request:
+    raised   : a device asserts its request, an exception is raised
+    sampled  : INT is sampled at the instruction boundary, state 18
+    entered  : the first instruction of the handler retires
+    returned : RTI pops the frame of the request
+only built with INTERRUPT_LATENCY, otherwise the hooks are nothing at all
+*/
+
+enum latency_source_t
+{
+    LATENCY_PRIVILEGE,
+    LATENCY_ILLEGAL,
+    LATENCY_KEYBOARD,
+    LATENCY_TIMER,
+    LATENCY_SOURCES
+};
+
+enum latency_phase_t
+{
+    //raised to sampled, time spent masked or between boundaries.
+    LATENCY_PENDING,
+    //sampled to entered, state 49 onwards plus the first handler instruction.
+    LATENCY_DISPATCH,
+    //entered to returned.
+    LATENCY_HANDLER,
+    //raised to returned.
+    LATENCY_TOTAL,
+    LATENCY_PHASES
+};
+
+//bucket b counts latencies under 2^b cycles.
+#define LATENCY_BUCKETS 32
+//nested handlers followed, deeper ones are counted in overflow.
+#define LATENCY_MAX_DEPTH 16
+#define LATENCY_NONE UINT64_MAX
+
+struct latency_histogram_t
+{
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t bucket[LATENCY_BUCKETS];
+};
+
+//a taken request whose handler has not returned yet.
+struct latency_frame_t
+{
+    uint8_t source;
+    uint8_t priority;
+    word_t handler;
+    uint64_t raised;
+    uint64_t sampled;
+    uint64_t entered;
+};
+
+struct latency_stats_t
+{
+    //cycle a request was raised at, LATENCY_NONE while none is outstanding.
+    uint64_t raised[LATENCY_SOURCES];
+
+    latency_frame_t frame[LATENCY_MAX_DEPTH];
+    uint32_t depth;
+    //the top frame waits for its handler's first instruction.
+    uint8_t entering;
+    uint64_t overflow;
+    //overflowed requests still in their handlers, their RTIs come first and pop nothing.
+    uint32_t unpushed;
+    //RTI with no frame taken, a handler entered before the stats were set.
+    uint64_t unmatched;
+
+    latency_histogram_t device[LATENCY_SOURCES][LATENCY_PHASES];
+    latency_histogram_t priority[8][LATENCY_PHASES];
+};
+
+void latency_init(latency_stats_t *s);
+
+inline uint8_t latency_source(uint8_t vector)
+{
+    switch(vector)
+    {
+    case PRIVILEGE_VECTOR:
+        return LATENCY_PRIVILEGE;
+    case ILLEGAL_OPCODE_VECTOR:
+        return LATENCY_ILLEGAL;
+    case KEYBOARD_VECTOR:
+        return LATENCY_KEYBOARD;
+    default:
+        return LATENCY_TIMER;
+    }
+}
+
+inline void latency_add(latency_stats_t *s, const latency_frame_t *f, latency_phase_t phase, uint64_t cycles)
+{
+    uint32_t b = cycles ? 64 - __builtin_clzll(cycles) : 0;
+    b = b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+    latency_histogram_t *h[2] = {&s->device[f->source][phase], &s->priority[f->priority & 7][phase]};
+    for(latency_histogram_t *x : h)
+    {
+        ++x->count;
+        x->total += cycles;
+        x->max = cycles > x->max ? cycles : x->max;
+        ++x->bucket[b];
+    }
+}
+
+//keep the first raise of a request that is still outstanding.
+inline void latency_raise(latency_stats_t *s, uint8_t source, uint64_t cycles)
+{
+    if(s->raised[source] == LATENCY_NONE)
+        s->raised[source] = cycles;
+}
+
+//the request went away without being taken.
+inline void latency_lower(latency_stats_t *s, uint8_t source)
+{
+    s->raised[source] = LATENCY_NONE;
+}
+
+//the request is taken, the machine enters handler at priority.
+inline void latency_take(latency_stats_t *s, uint8_t vector, word_t priority, word_t handler, uint64_t cycles)
+{
+    uint8_t source = latency_source(vector);
+    uint64_t raised = s->raised[source] == LATENCY_NONE ? cycles : s->raised[source];
+    s->raised[source] = LATENCY_NONE;
+    if(s->depth == LATENCY_MAX_DEPTH)
+    {
+        ++s->overflow;
+        ++s->unpushed;
+        return;
+    }
+    latency_frame_t *f = &s->frame[s->depth++];
+    f->source = source;
+    f->priority = (uint8_t)priority;
+    f->handler = handler;
+    f->raised = raised;
+    f->sampled = cycles;
+    f->entered = cycles;
+    latency_add(s, f, LATENCY_PENDING, cycles - raised);
+    s->entering = 1;
+}
+
+inline void latency_retire(latency_stats_t *s, word_t pc, uint64_t cycles)
+{
+    latency_frame_t *f = &s->frame[s->depth - 1];
+    //the instruction that raised an exception retires before its handler runs,
+    //an overflowed handler may share the address of the top frame's.
+    if(pc != f->handler || s->unpushed)
+        return;
+    s->entering = 0;
+    f->entered = cycles;
+    latency_add(s, f, LATENCY_DISPATCH, cycles - f->sampled);
+}
+
+inline void latency_return(latency_stats_t *s, uint64_t cycles)
+{
+    if(s->unpushed)
+    {
+        --s->unpushed;
+        return;
+    }
+    if(s->depth == 0)
+    {
+        ++s->unmatched;
+        return;
+    }
+    const latency_frame_t *f = &s->frame[--s->depth];
+    s->entering = 0;
+    latency_add(s, f, LATENCY_HANDLER, cycles - f->entered);
+    latency_add(s, f, LATENCY_TOTAL, cycles - f->raised);
+}
+
+//one table per device and per priority level, then the nonempty buckets.
+void latency_write(const latency_stats_t *s, FILE *out);
+
+#ifdef INTERRUPT_LATENCY
+#define LATENCY_RAISE(m, source) \
+    do { if((m)->latency) latency_raise((m)->latency, source, (m)->cycles); } while(0)
+#define LATENCY_LOWER(m, source) \
+    do { if((m)->latency) latency_lower((m)->latency, source); } while(0)
+#define LATENCY_TAKE(m, vector, priority, handler) \
+    do { if((m)->latency) latency_take((m)->latency, vector, priority, handler, (m)->cycles); } while(0)
+#define LATENCY_RETIRE(m, pc) \
+    do { if((m)->latency && (m)->latency->entering) latency_retire((m)->latency, pc, (m)->cycles); } while(0)
+#define LATENCY_RETURN(m) \
+    do { if((m)->latency) latency_return((m)->latency, (m)->cycles); } while(0)
+#else
+#define LATENCY_RAISE(m, source) do {} while(0)
+#define LATENCY_LOWER(m, source) do {} while(0)
+#define LATENCY_TAKE(m, vector, priority, handler) do {} while(0)
+#define LATENCY_RETIRE(m, pc) do {} while(0)
+#define LATENCY_RETURN(m) do {} while(0)
+#endif
+
+#endif //LATENCY_H
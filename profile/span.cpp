@@ -0,0 +1,143 @@
+#include<string.h>
+#include<time.h>
+#include<pthread.h>
+
+#include"span.h"
+
+volatile uint8_t span_enabled = 0;
+
+static const char *span_names[SPAN_KIND_COUNT] =
+{
+    "queue", "image_load", "decode_warm", "translate",
+    "execute", "output", "result_lookup", "job"
+};
+
+static pthread_mutex_t span_lock = PTHREAD_MUTEX_INITIALIZER;
+static span_ring_t *span_rings = 0;
+static uint32_t span_threads = 0;
+static __thread span_ring_t *span_local = 0;
+
+//calibration base, ticks and nanoseconds read together.
+static uint64_t span_base_ticks = 0;
+static uint64_t span_base_ns = 0;
+static uint64_t span_slow_us = 0;
+static char span_slow_path[256];
+static uint8_t span_dumping = 0;
+
+uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//ticks per microsecond since span_enable, 1000 before any time has passed.
+static double ticks_per_us()
+{
+    uint64_t ticks = span_now() - span_base_ticks;
+    uint64_t ns = monotonic_ns() - span_base_ns;
+    if(ns < 1000 || ticks == 0)
+        return 1000.0;
+    return (double)ticks * 1000.0 / (double)ns;
+}
+
+static span_ring_t *ring_local()
+{
+    if(!span_local)
+    {
+        span_ring_t *ring = new span_ring_t();
+        pthread_mutex_lock(&span_lock);
+        ring->tid = ++span_threads;
+        ring->next = span_rings;
+        span_rings = ring;
+        pthread_mutex_unlock(&span_lock);
+        span_local = ring;
+    }
+    return span_local;
+}
+
+void span_enable(uint64_t slow_us, const char *slow_path)
+{
+    span_base_ticks = span_now();
+    span_base_ns = monotonic_ns();
+    span_slow_us = slow_us;
+    span_slow_path[0] = 0;
+    if(slow_path)
+    {
+        strncpy(span_slow_path, slow_path, sizeof(span_slow_path) - 1);
+        span_slow_path[sizeof(span_slow_path) - 1] = 0;
+    }
+    span_enabled = 1;
+}
+
+void span_disable()
+{
+    span_enabled = 0;
+}
+
+void span_record(span_kind_t kind, uint64_t begin, uint32_t arg)
+{
+    uint64_t end = span_now();
+    span_ring_t *ring = ring_local();
+    span_t &span = ring->spans[ring->head & (SPAN_RING - 1)];
+    span.begin = begin;
+    span.end = end;
+    span.kind = kind;
+    span.arg = arg;
+    //published after the slot, a dump from another thread reads head first.
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+
+    if(kind == SPAN_JOB && span_slow_us && span_slow_path[0] && end - begin > span_slow_us * ticks_per_us())
+    {
+        pthread_mutex_lock(&span_lock);
+        bool dump = !span_dumping;
+        span_dumping = 1;
+        pthread_mutex_unlock(&span_lock);
+        if(dump)
+        {
+            span_dump_file(span_slow_path);
+            pthread_mutex_lock(&span_lock);
+            span_dumping = 0;
+            pthread_mutex_unlock(&span_lock);
+        }
+    }
+}
+
+void span_dump(FILE *out)
+{
+    double rate = ticks_per_us();
+    fprintf(out, "{\"traceEvents\":[");
+    bool first = true;
+
+    pthread_mutex_lock(&span_lock);
+    for(span_ring_t *ring = span_rings; ring; ring = ring->next)
+    {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t count = head < SPAN_RING ? head : SPAN_RING;
+        for(uint64_t i = head - count; i < head; ++i)
+        {
+            const span_t &span = ring->spans[i & (SPAN_RING - 1)];
+            if(span.kind >= SPAN_KIND_COUNT || span.end < span.begin || span.begin < span_base_ticks)
+                continue;
+            fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"lc3sim\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%u}}",
+                    first ? "" : ",", span_names[span.kind], ring->tid,
+                    (double)(span.begin - span_base_ticks) / rate,
+                    (double)(span.end - span.begin) / rate, span.arg);
+            first = false;
+        }
+    }
+    pthread_mutex_unlock(&span_lock);
+
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+bool span_dump_file(const char *path)
+{
+    FILE *out = fopen(path, "w");
+    if(!out)
+        return false;
+    span_dump(out);
+    fclose(out);
+    return true;
+}
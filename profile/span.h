@@ -0,0 +1,88 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include<stdio.h>
+#include<time.h>
+
+#include"../type/type.h"
+
+//spans kept per thread, the oldest are overwritten.
+#define SPAN_RING 0x1000
+
+//where host time goes, one name per kind in the dump.
+enum span_kind_t
+{
+    SPAN_QUEUE,
+    SPAN_IMAGE_LOAD,
+    SPAN_DECODE_WARM,
+    SPAN_TRANSLATE,
+    SPAN_EXECUTE,
+    SPAN_OUTPUT,
+    SPAN_RESULT_LOOKUP,
+    SPAN_JOB,
+    SPAN_KIND_COUNT
+};
+
+struct span_t
+{
+    uint64_t begin;
+    uint64_t end;
+    uint32_t kind;
+    uint32_t arg;
+};
+
+//written by its thread only, head counts every span ever recorded.
+struct span_ring_t
+{
+    span_t spans[SPAN_RING];
+    uint64_t head;
+    uint32_t tid;
+    span_ring_t *next;
+};
+
+//0 until span_enable, the SPAN_ macros then cost a load and a branch.
+extern volatile uint8_t span_enabled;
+
+inline uint64_t span_now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+//CLOCK_MONOTONIC in nanoseconds, for wall time that must not depend on the TSC.
+uint64_t monotonic_ns();
+
+/*
+function define:
+    start recording, the tick rate is calibrated against CLOCK_MONOTONIC
+    between this call and the dump
+    a SPAN_JOB longer than slow_us dumps every ring to slow_path,
+    slow_us 0 disables the detection
+*/
+void span_enable(uint64_t slow_us, const char *slow_path);
+void span_disable();
+
+//close a span opened at begin on the calling thread's ring.
+void span_record(span_kind_t kind, uint64_t begin, uint32_t arg);
+
+//every thread's ring in Chrome trace event format, load in chrome://tracing or Perfetto.
+//a ring that wrapped while being dumped may show its oldest span torn.
+void span_dump(FILE *out);
+bool span_dump_file(const char *path);
+
+#define SPAN_BEGIN(var) uint64_t var = span_enabled ? span_now() : 0
+#define SPAN_END(var, kind, arg) \
+    do \
+    { \
+        if(span_enabled && var) \
+            span_record(kind, var, arg); \
+    } while(0)
+
+#endif //SPAN_H
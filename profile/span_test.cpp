@@ -0,0 +1,193 @@
+#include<stdio.h>
+#include<string.h>
+#include<time.h>
+#include<pthread.h>
+#include<vector>
+
+#include"span.h"
+#include"../test/check.h"
+
+#define JOBS 6
+#define SLOW_PATH "span_test_slow.json"
+
+struct event_t
+{
+    char name[32];
+    uint32_t tid;
+    double ts;
+    double dur;
+    uint32_t arg;
+};
+
+static void *worker(void *)
+{
+    for(uint32_t k = 0; k < JOBS; ++k)
+    {
+        SPAN_BEGIN(job);
+        SPAN_BEGIN(execute);
+        //long enough for the slow job dump, both threads race for it.
+        struct timespec wait = {0, 200000};
+        nanosleep(&wait, 0);
+        SPAN_END(execute, SPAN_EXECUTE, k);
+        SPAN_BEGIN(output);
+        SPAN_END(output, SPAN_OUTPUT, k);
+        SPAN_END(job, SPAN_JOB, k);
+    }
+    return 0;
+}
+
+//a minimal JSON grammar check, p is left after the value.
+static bool json_value(const char *&p);
+
+static void json_space(const char *&p)
+{
+    while(*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')
+        ++p;
+}
+
+static bool json_string(const char *&p)
+{
+    if(*p != '"')
+        return false;
+    for(++p; *p && *p != '"'; ++p)
+    {
+        if(*p == '\\' && !*++p)
+            return false;
+    }
+    return *p++ == '"';
+}
+
+static bool json_list(const char *&p, char close, bool object)
+{
+    ++p;
+    json_space(p);
+    if(*p == close)
+    {
+        ++p;
+        return true;
+    }
+    for(;;)
+    {
+        if(object)
+        {
+            if(!json_string(p))
+                return false;
+            json_space(p);
+            if(*p++ != ':')
+                return false;
+        }
+        if(!json_value(p))
+            return false;
+        json_space(p);
+        if(*p == close)
+        {
+            ++p;
+            return true;
+        }
+        if(*p++ != ',')
+            return false;
+        json_space(p);
+    }
+}
+
+static bool json_value(const char *&p)
+{
+    json_space(p);
+    if(*p == '{')
+        return json_list(p, '}', true);
+    if(*p == '[')
+        return json_list(p, ']', false);
+    if(*p == '"')
+        return json_string(p);
+    //numbers only, span_dump writes no literals.
+    const char *begin = p;
+    if(*p == '-')
+        ++p;
+    while((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')
+        ++p;
+    return p != begin && begin[*begin == '-'] >= '0' && begin[*begin == '-'] <= '9';
+}
+
+static bool json_valid(const std::vector<char> &text)
+{
+    const char *p = text.data();
+    if(!json_value(p))
+        return false;
+    json_space(p);
+    return *p == 0;
+}
+
+static std::vector<char> read_file(FILE *f)
+{
+    std::vector<char> text;
+    char buf[0x1000];
+    size_t n;
+    rewind(f);
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        text.insert(text.end(), buf, buf + n);
+    text.push_back(0);
+    return text;
+}
+
+int main()
+{
+    remove(SLOW_PATH);
+    span_enable(100, SLOW_PATH);
+    pthread_t threads[2];
+    for(int t = 0; t < 2; ++t)
+        pthread_create(&threads[t], 0, worker, 0);
+    for(int t = 0; t < 2; ++t)
+        pthread_join(threads[t], 0);
+    span_disable();
+
+    FILE *out = tmpfile();
+    span_dump(out);
+    std::vector<char> text = read_file(out);
+    fclose(out);
+    CHECK(json_valid(text));
+
+    //one event per line, in the layout span_dump writes.
+    std::vector<event_t> events;
+    for(const char *line = strstr(text.data(), "\n{"); line; line = strstr(line + 1, "\n{"))
+    {
+        event_t e;
+        if(sscanf(line + 1, "{\"name\":\"%31[^\"]\",\"cat\":\"lc3sim\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                  "\"ts\":%lf,\"dur\":%lf,\"args\":{\"arg\":%u}}", e.name, &e.tid, &e.ts, &e.dur, &e.arg) == 5)
+            events.push_back(e);
+    }
+    CHECK(events.size() == 2 * 3 * JOBS);
+
+    //every span begins before it ends and sits inside the job of its thread, %.3f rounds each value.
+    uint32_t tids = 0;
+    for(const event_t &e : events)
+    {
+        CHECK(e.ts >= 0 && e.dur >= 0);
+        tids |= 1u << e.tid;
+        if(!strcmp(e.name, "job"))
+            continue;
+        CHECK(!strcmp(e.name, "execute") || !strcmp(e.name, "output"));
+        int parents = 0;
+        for(const event_t &job : events)
+        {
+            if(strcmp(job.name, "job") || job.tid != e.tid || job.arg != e.arg)
+                continue;
+            ++parents;
+            CHECK(job.ts <= e.ts + 0.002 && e.ts + e.dur <= job.ts + job.dur + 0.002);
+        }
+        CHECK(parents == 1);
+    }
+    CHECK(tids == ((1u << 1) | (1u << 2)));
+
+    //the slow job dump was written whole.
+    FILE *slow = fopen(SLOW_PATH, "r");
+    CHECK(slow);
+    if(slow)
+    {
+        std::vector<char> slow_text = read_file(slow);
+        fclose(slow);
+        CHECK(json_valid(slow_text) && strstr(slow_text.data(), "\"name\":\"job\""));
+    }
+    remove(SLOW_PATH);
+
+    return check_result();
+}
@@ -0,0 +1,196 @@
+#include<string.h>
+
+#include"page_store.h"
+#include"../probe/probe.h"
+
+//words of mem held by page p.
+static uint32_t page_words(uint32_t p)
+{
+    uint32_t begin = p * PAGE_WORDS;
+    return MEM_WORDS - begin < PAGE_WORDS ? MEM_WORDS - begin : PAGE_WORDS;
+}
+
+//FNV-1a over the words of a page.
+page_hash_t page_hash(const word_t *data, uint32_t words)
+{
+    page_hash_t h = 0xcbf29ce484222325ULL;
+    for(uint32_t i = 0; i < words; ++i)
+    {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+//return the id of a page equal to data, storing it first if it is new.
+static page_id_t page_intern(page_store_t *store, const word_t *data, uint32_t words)
+{
+    page_hash_t h = page_hash(data, words);
+
+    auto range = store->index.equal_range(h);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        page_t &page = store->pages[it->second];
+        if(memcmp(page.data, data, words * sizeof(word_t)) == 0)
+        {
+            ++page.refs;
+            return it->second;
+        }
+    }
+
+    page_id_t id;
+    if(!store->free_pages.empty())
+    {
+        id = store->free_pages.back();
+        store->free_pages.pop_back();
+    }
+    else
+    {
+        id = (page_id_t)store->pages.size();
+        store->pages.push_back(page_t());
+    }
+
+    page_t &page = store->pages[id];
+    memcpy(page.data, data, words * sizeof(word_t));
+    //the short last page is kept zero padded.
+    memset(page.data + words, 0, (PAGE_WORDS - words) * sizeof(word_t));
+    page.hash = h;
+    page.refs = 1;
+    store->index.insert({h, id});
+    return id;
+}
+
+static void page_release(page_store_t *store, page_id_t id)
+{
+    page_t &page = store->pages[id];
+    if(--page.refs)
+        return;
+
+    auto range = store->index.equal_range(page.hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        if(it->second == id)
+        {
+            store->index.erase(it);
+            break;
+        }
+    }
+    store->free_pages.push_back(id);
+}
+
+static snapshot_id_t snapshot_alloc(page_store_t *store)
+{
+    snapshot_id_t id;
+    if(!store->free_snapshots.empty())
+    {
+        id = store->free_snapshots.back();
+        store->free_snapshots.pop_back();
+    }
+    else
+    {
+        id = (snapshot_id_t)store->snapshots.size();
+        store->snapshots.push_back(snapshot_t());
+    }
+    store->snapshots[id].refs = 1;
+    return id;
+}
+
+snapshot_id_t snapshot_take(page_store_t *store, const word_t *mem)
+{
+    snapshot_id_t id = snapshot_alloc(store);
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        store->snapshots[id].page[p] = page_intern(store, mem + p * PAGE_WORDS, page_words(p));
+    }
+    PROBE1(snapshot_take, id);
+    return id;
+}
+
+snapshot_id_t snapshot_take_dirty(page_store_t *store, snapshot_id_t base,
+                                  const word_t *mem, const uint8_t *dirty)
+{
+    snapshot_id_t id = snapshot_alloc(store);
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        page_id_t page_id;
+        if(dirty[p])
+        {
+            page_id = page_intern(store, mem + p * PAGE_WORDS, page_words(p));
+        }
+        else
+        {
+            page_id = store->snapshots[base].page[p];
+            ++store->pages[page_id].refs;
+        }
+        store->snapshots[id].page[p] = page_id;
+    }
+    PROBE1(snapshot_take, id);
+    return id;
+}
+
+void snapshot_diff(const page_store_t *store, snapshot_id_t id, const word_t *mem, uint8_t *dirty)
+{
+    const snapshot_t &snapshot = store->snapshots[id];
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        dirty[p] = memcmp(mem + p * PAGE_WORDS, store->pages[snapshot.page[p]].data,
+                          page_words(p) * sizeof(word_t)) != 0;
+    }
+}
+
+void snapshot_restore(const page_store_t *store, snapshot_id_t id, word_t *mem)
+{
+    PROBE1(snapshot_restore, id);
+    const snapshot_t &snapshot = store->snapshots[id];
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        memcpy(mem + p * PAGE_WORDS, store->pages[snapshot.page[p]].data,
+               page_words(p) * sizeof(word_t));
+    }
+}
+
+void snapshot_restore_delta(const page_store_t *store, snapshot_id_t from,
+                            snapshot_id_t to, word_t *mem)
+{
+    const snapshot_t &from_snapshot = store->snapshots[from];
+    const snapshot_t &to_snapshot = store->snapshots[to];
+    PROBE1(snapshot_restore, to);
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        //equal ids mean equal content.
+        if(from_snapshot.page[p] == to_snapshot.page[p])
+            continue;
+        memcpy(mem + p * PAGE_WORDS, store->pages[to_snapshot.page[p]].data,
+               page_words(p) * sizeof(word_t));
+    }
+}
+
+void snapshot_retain(page_store_t *store, snapshot_id_t id)
+{
+    ++store->snapshots[id].refs;
+}
+
+void snapshot_release(page_store_t *store, snapshot_id_t id)
+{
+    snapshot_t &snapshot = store->snapshots[id];
+    if(--snapshot.refs)
+        return;
+
+    for(uint32_t p = 0; p < PAGE_COUNT; ++p)
+    {
+        page_release(store, snapshot.page[p]);
+        snapshot.page[p] = INVALID_PAGE_ID;
+    }
+    store->free_snapshots.push_back(id);
+}
+
+uint32_t page_store_unique_pages(const page_store_t *store)
+{
+    return (uint32_t)(store->pages.size() - store->free_pages.size());
+}
+
+uint64_t page_store_bytes(const page_store_t *store)
+{
+    uint64_t live_snapshots = store->snapshots.size() - store->free_snapshots.size();
+    return (uint64_t)page_store_unique_pages(store) * sizeof(page_t) +
+           live_snapshots * sizeof(snapshot_t);
+}
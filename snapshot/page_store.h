@@ -0,0 +1,78 @@
+#ifndef PAGE_STORE_H
+#define PAGE_STORE_H
+
+#include<vector>
+#include<unordered_map>
+
+#include"../type/type.h"
+
+//mem is split into PAGE_COUNT pages of PAGE_WORDS words.
+//the last page is one word short because mem holds UINT16_MAX words.
+#define PAGE_WORDS 0x100
+#define PAGE_COUNT 0x100
+#define MEM_WORDS UINT16_MAX
+
+#define PAGE_OF(addr) (uint16_t)((addr) >> 8)
+
+#define INVALID_PAGE_ID UINT32_MAX
+#define INVALID_SNAPSHOT_ID UINT32_MAX
+
+typedef uint32_t page_id_t;
+typedef uint32_t snapshot_id_t;
+typedef uint64_t page_hash_t;
+
+//one unique page, shared by every snapshot whose page list names it.
+struct page_t
+{
+    word_t data[PAGE_WORDS];
+    page_hash_t hash;
+    uint32_t refs;
+};
+
+//page list of one snapshot, refs counts the holders of the list itself.
+struct snapshot_t
+{
+    page_id_t page[PAGE_COUNT];
+    uint32_t refs;
+};
+
+struct page_store_t
+{
+    std::vector<page_t> pages;
+    std::vector<page_id_t> free_pages;
+    std::unordered_multimap<page_hash_t, page_id_t> index;
+
+    std::vector<snapshot_t> snapshots;
+    std::vector<snapshot_id_t> free_snapshots;
+};
+
+page_hash_t page_hash(const word_t *data, uint32_t words);
+
+//store every page of mem once, return the new snapshot.
+snapshot_id_t snapshot_take(page_store_t *store, const word_t *mem);
+
+//like snapshot_take, only the pages marked in dirty are hashed again,
+//the others are taken over from base.
+snapshot_id_t snapshot_take_dirty(page_store_t *store, snapshot_id_t base,
+                                  const word_t *mem, const uint8_t *dirty);
+
+//mark in dirty the pages of mem that differ from snapshot id, for snapshot_take_dirty.
+void snapshot_diff(const page_store_t *store, snapshot_id_t id, const word_t *mem, uint8_t *dirty);
+
+//copy the snapshot back into mem page by page.
+void snapshot_restore(const page_store_t *store, snapshot_id_t id, word_t *mem);
+
+//mem holds snapshot from, only copy the pages that differ in snapshot to.
+void snapshot_restore_delta(const page_store_t *store, snapshot_id_t from,
+                            snapshot_id_t to, word_t *mem);
+
+//add a holder to a snapshot, used when a machine forks.
+void snapshot_retain(page_store_t *store, snapshot_id_t id);
+
+//drop a holder, the page list and its unused pages are freed at zero.
+void snapshot_release(page_store_t *store, snapshot_id_t id);
+
+uint32_t page_store_unique_pages(const page_store_t *store);
+uint64_t page_store_bytes(const page_store_t *store);
+
+#endif //PAGE_STORE_H
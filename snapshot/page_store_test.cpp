@@ -0,0 +1,45 @@
+#include<stdio.h>
+#include<vector>
+
+#include"page_store.h"
+#include"../test/check.h"
+
+int main()
+{
+    page_store_t store;
+    std::vector<word_t> mem(MEM_WORDS, 0);
+    for(uint32_t a = 0x3000; a < 0x3100; ++a)
+        mem[a] = (word_t)(a * 7);
+
+    //every zero page of mem is one unique page.
+    snapshot_id_t a = snapshot_take(&store, mem.data());
+    CHECK(page_store_unique_pages(&store) == 3);
+
+    //a second machine with the same image shares every page.
+    snapshot_id_t b = snapshot_take(&store, mem.data());
+    CHECK(page_store_unique_pages(&store) == 3);
+
+    //one dirty page adds one page.
+    std::vector<uint8_t> dirty(PAGE_COUNT, 0);
+    mem[0x4000] = 0x1234;
+    dirty[PAGE_OF(0x4000)] = 1;
+    snapshot_id_t c = snapshot_take_dirty(&store, b, mem.data(), dirty.data());
+    CHECK(page_store_unique_pages(&store) == 4);
+
+    std::vector<word_t> out(MEM_WORDS, 0xFFFF);
+    snapshot_restore(&store, a, out.data());
+    CHECK(out[0x3005] == (word_t)(0x3005 * 7) && out[0x4000] == 0 && out[0] == 0);
+    CHECK(out[MEM_WORDS - 1] == 0);
+
+    snapshot_restore_delta(&store, a, c, out.data());
+    CHECK(out == mem);
+
+    //freed pages go back to the store once no snapshot names them.
+    snapshot_release(&store, c);
+    CHECK(page_store_unique_pages(&store) == 3);
+    snapshot_release(&store, a);
+    snapshot_release(&store, b);
+    CHECK(page_store_unique_pages(&store) == 0);
+
+    return check_result();
+}
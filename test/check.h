@@ -0,0 +1,19 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include<stdio.h>
+
+//shared by the *_test programs, every failed CHECK is printed and counted.
+static int failures = 0;
+
+#define CHECK(...) do { if(!(__VA_ARGS__)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #__VA_ARGS__); ++failures; } } while(0)
+
+//the exit status of a test program.
+static int check_result()
+{
+    if(failures)
+        fprintf(stderr, "%d failures\n", failures);
+    return failures ? 1 : 0;
+}
+
+#endif //CHECK_H
@@ -0,0 +1,406 @@
+#include<stdio.h>
+#include<string.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#include"column.h"
+#include"../engine/engine.h"
+
+static uint64_t column_align(uint64_t offset)
+{
+    return (offset + 7) & ~7ull;
+}
+
+static void put_word(std::vector<uint8_t> *bytes, word_t w)
+{
+    bytes->push_back((uint8_t)w);
+    bytes->push_back((uint8_t)(w >> 8));
+}
+
+static word_t get_word(const uint8_t *p)
+{
+    return (word_t)(p[0] | (p[1] << 8));
+}
+
+//code one column of the open chunk into w->bytes, return its coding.
+static column_coding_t column_encode(column_writer_t *w, const std::vector<word_t> &values)
+{
+    uint32_t n = (uint32_t)values.size();
+    bool same = true;
+    bool small = true;
+    for(uint32_t i = 1; i < n; ++i)
+    {
+        int32_t delta = (int32_t)(int16_t)(values[i] - values[i - 1]);
+        same = same && delta == 0;
+        small = small && delta >= -128 && delta <= 127;
+    }
+
+    w->bytes.clear();
+    if(same)
+    {
+        put_word(&w->bytes, values[0]);
+        return CODING_CONST;
+    }
+    if(small)
+    {
+        put_word(&w->bytes, values[0]);
+        for(uint32_t i = 1; i < n; ++i)
+            w->bytes.push_back((uint8_t)(values[i] - values[i - 1]));
+        return CODING_DELTA8;
+    }
+
+    //a byte per row beats a word per row once the words fit a dictionary.
+    std::vector<int16_t> slot(0x10000, -1);
+    std::vector<word_t> dict;
+    for(uint32_t i = 0; i < n && dict.size() <= 0x100; ++i)
+    {
+        if(slot[values[i]] < 0)
+        {
+            slot[values[i]] = (int16_t)dict.size();
+            dict.push_back(values[i]);
+        }
+    }
+    if(dict.size() <= 0x100 && 2 + 2 * dict.size() + n < 2ull * n)
+    {
+        put_word(&w->bytes, (word_t)dict.size());
+        for(word_t d : dict)
+            put_word(&w->bytes, d);
+        for(uint32_t i = 0; i < n; ++i)
+            w->bytes.push_back((uint8_t)slot[values[i]]);
+        return CODING_DICT8;
+    }
+
+    for(uint32_t i = 0; i < n; ++i)
+        put_word(&w->bytes, values[i]);
+    return CODING_RAW;
+}
+
+static bool column_flush(column_writer_t *w)
+{
+    uint32_t n = (uint32_t)w->column[COLUMN_PC].size();
+    if(!n)
+        return true;
+
+    column_chunk_t chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.first_row = w->rows - n;
+    chunk.rows = n;
+    chunk.pc_min = 0xFFFF;
+    chunk.pc_max = 0;
+    for(word_t pc : w->column[COLUMN_PC])
+    {
+        chunk.pc_min = pc < chunk.pc_min ? pc : chunk.pc_min;
+        chunk.pc_max = pc > chunk.pc_max ? pc : chunk.pc_max;
+    }
+    for(word_t c : w->column[COLUMN_CYCLES])
+        chunk.cycles += c;
+
+    static const uint8_t pad[8] = {0};
+    for(int c = 0; c < COLUMN_COUNT; ++c)
+    {
+        column_span_t &span = chunk.column[c];
+        span.coding = column_encode(w, w->column[c]);
+        span.offset = w->offset;
+        span.bytes = (uint32_t)w->bytes.size();
+        uint64_t end = column_align(w->offset + span.bytes);
+        if(fwrite(w->bytes.data(), 1, span.bytes, w->out) != span.bytes ||
+           fwrite(pad, 1, end - w->offset - span.bytes, w->out) != end - w->offset - span.bytes)
+            return false;
+        w->offset = end;
+        w->column[c].clear();
+    }
+    w->index.push_back(chunk);
+    return true;
+}
+
+bool column_writer_open(column_writer_t *w, const char *path, isa_variant_t isa, uint32_t chunk_rows)
+{
+    if(chunk_rows > COLUMN_CHUNK_ROWS)
+        return false;
+    w->out = fopen(path, "wb");
+    if(!w->out)
+        return false;
+    w->isa = isa;
+    w->rows = 0;
+    w->failed = false;
+    w->index.clear();
+    w->chunk_rows = chunk_rows ? chunk_rows : COLUMN_CHUNK_ROWS;
+    for(int c = 0; c < COLUMN_COUNT; ++c)
+    {
+        w->column[c].clear();
+        w->column[c].reserve(w->chunk_rows);
+    }
+    memset(w->reg, 0, sizeof(w->reg));
+    w->cycles = 0;
+
+    //the header is written again once the index is known.
+    column_header_t header;
+    memset(&header, 0, sizeof(header));
+    w->offset = column_align(sizeof(header));
+    static const uint8_t pad[8] = {0};
+    if(fwrite(&header, sizeof(header), 1, w->out) != 1 ||
+       fwrite(pad, 1, w->offset - sizeof(header), w->out) != w->offset - sizeof(header))
+    {
+        fclose(w->out);
+        w->out = 0;
+        return false;
+    }
+    return true;
+}
+
+void column_writer_append(column_writer_t *w, word_t pc, word_t ir, word_t addr, word_t value, uint16_t cycles)
+{
+    w->column[COLUMN_PC].push_back(pc);
+    w->column[COLUMN_IR].push_back(ir);
+    w->column[COLUMN_ADDR].push_back(addr);
+    w->column[COLUMN_VALUE].push_back(value);
+    w->column[COLUMN_CYCLES].push_back(cycles);
+    ++w->rows;
+    if(w->column[COLUMN_PC].size() == w->chunk_rows && !column_flush(w))
+        w->failed = true;
+}
+
+//the word at addr as the program sees it, device registers are not read.
+template<typename isa_t>
+static word_t column_peek(const machine_t *m, word_t addr)
+{
+    if(addr >= DEVICE_REGISTER_ADDR)
+        return 0;
+    return m->mem[addr >> isa_t::offset_shift];
+}
+
+/*
+function define:
+    recover the data access of the instruction just retired from IR and
+    the registers before and after it
+*/
+template<typename isa_t>
+static void column_access(const column_writer_t *w, const machine_t *m, word_t pc, word_t ir,
+                          word_t *addr, word_t *value)
+{
+    word_t next = pc + isa_t::pc_step;
+    uint32_t dr = IR_DR(ir);
+    uint32_t base = IR_SR1(ir);
+    op_t op = isa_t::opcode_map[ir >> 12];
+    switch(op)
+    {
+    case OP_LD:
+    case OP_ST:
+        *addr = next + (word_t)(sign_extend(ir, 9) << isa_t::offset_shift);
+        *value = m->reg[dr];
+        break;
+    case OP_LDI:
+    case OP_STI:
+        *addr = column_peek<isa_t>(m, next + (word_t)(sign_extend(ir, 9) << isa_t::offset_shift));
+        *value = m->reg[dr];
+        break;
+    case OP_LDR:
+    case OP_LDW:
+    case OP_LDB:
+        //the load may have overwritten its own base.
+        *addr = (dr == base ? w->reg[base] : m->reg[base]) +
+                (op == OP_LDB ? sign_extend(ir, 6) : (word_t)(sign_extend(ir, 6) << isa_t::offset_shift));
+        *value = m->reg[dr];
+        break;
+    case OP_STR:
+    case OP_STW:
+    case OP_STB:
+        *addr = m->reg[base] + (op == OP_STB ? sign_extend(ir, 6) : (word_t)(sign_extend(ir, 6) << isa_t::offset_shift));
+        *value = op == OP_STB ? (word_t)(m->reg[dr] & 0xFF) : m->reg[dr];
+        break;
+    case OP_TRAP:
+        *addr = isa_t::trap_table + ((ir & 0xFF) << isa_t::offset_shift);
+        *value = column_peek<isa_t>(m, *addr);
+        break;
+    case OP_RTI:
+        //the PC pop, R6 may have switched stacks since.
+        *addr = w->reg[6];
+        *value = m->pc;
+        break;
+    default:
+        *addr = 0;
+        *value = 0;
+        break;
+    }
+}
+
+static void column_trace(machine_t *m, word_t pc, word_t ir, void *ctx)
+{
+    column_writer_t *w = (column_writer_t *)ctx;
+    word_t addr;
+    word_t value;
+    if(m->isa == ISA_LC3B)
+        column_access<lc3b_isa_t>(w, m, pc, ir, &addr, &value);
+    else
+        column_access<lc3_isa_t>(w, m, pc, ir, &addr, &value);
+
+    uint64_t cycles = m->cycles - w->cycles;
+    column_writer_append(w, pc, ir, addr, value, (uint16_t)(cycles < 0xFFFF ? cycles : 0xFFFF));
+    memcpy(w->reg, m->reg, sizeof(w->reg));
+    w->cycles = m->cycles;
+}
+
+void column_writer_attach(column_writer_t *w, machine_t *m)
+{
+    memcpy(w->reg, m->reg, sizeof(w->reg));
+    w->cycles = m->cycles;
+    m->trace = column_trace;
+    m->trace_ctx = w;
+}
+
+bool column_writer_close(column_writer_t *w)
+{
+    bool ok = !w->failed && column_flush(w);
+
+    column_header_t header;
+    header.magic = COLUMN_MAGIC;
+    header.version = COLUMN_VERSION;
+    header.isa = (uint16_t)w->isa;
+    header.chunk_rows = w->chunk_rows;
+    header.chunk_count = (uint32_t)w->index.size();
+    header.rows = w->rows;
+    header.index_offset = w->offset;
+    ok = ok && fwrite(w->index.data(), sizeof(column_chunk_t), w->index.size(), w->out) == w->index.size();
+    ok = ok && fseek(w->out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, w->out) == 1;
+    ok = fclose(w->out) == 0 && ok;
+    w->out = 0;
+    w->index.clear();
+    return ok;
+}
+
+//a span of bytes lies inside the trace.
+static bool span_valid(const column_trace_t *trace, uint64_t offset, uint64_t bytes)
+{
+    return offset <= trace->size && bytes <= trace->size - offset;
+}
+
+//a coded column holds exactly rows values.
+static bool coding_valid(const column_trace_t *trace, const column_span_t *span, uint32_t rows)
+{
+    if(!span_valid(trace, span->offset, span->bytes))
+        return false;
+    switch(span->coding)
+    {
+    case CODING_CONST:
+        return span->bytes == 2;
+    case CODING_DELTA8:
+        return span->bytes == 1ull + rows;
+    case CODING_DICT8:
+    {
+        if(span->bytes < 2)
+            return false;
+        uint32_t count = get_word(trace->base + span->offset);
+        return count && count <= 0x100 && span->bytes == 2ull + 2 * count + rows;
+    }
+    case CODING_RAW:
+        return span->bytes == 2ull * rows;
+    default:
+        return false;
+    }
+}
+
+bool column_trace_open(column_trace_t *trace, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(column_header_t))
+    {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+    //chunks are read front to back.
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    trace->base = (const uint8_t *)data;
+    trace->size = (uint64_t)st.st_size;
+    trace->header = (const column_header_t *)data;
+    trace->chunks = 0;
+
+    const column_header_t *h = trace->header;
+    bool ok = h->magic == COLUMN_MAGIC && h->version == COLUMN_VERSION &&
+              h->chunk_rows && h->chunk_rows <= COLUMN_CHUNK_ROWS &&
+              h->index_offset % 8 == 0 &&
+              span_valid(trace, h->index_offset, (uint64_t)h->chunk_count * sizeof(column_chunk_t));
+    if(ok)
+    {
+        trace->chunks = (const column_chunk_t *)(trace->base + h->index_offset);
+        //every span is checked once here and trusted by column_decode.
+        for(uint32_t i = 0; ok && i < h->chunk_count; ++i)
+        {
+            const column_chunk_t *chunk = &trace->chunks[i];
+            ok = chunk->rows && chunk->rows <= h->chunk_rows;
+            for(int c = 0; ok && c < COLUMN_COUNT; ++c)
+                ok = coding_valid(trace, &chunk->column[c], chunk->rows);
+        }
+    }
+    if(!ok)
+    {
+        munmap(data, (size_t)st.st_size);
+        trace->base = 0;
+        trace->size = 0;
+        return false;
+    }
+    return true;
+}
+
+void column_trace_close(column_trace_t *trace)
+{
+    if(trace->base)
+        munmap((void *)trace->base, (size_t)trace->size);
+    trace->base = 0;
+    trace->size = 0;
+}
+
+void column_decode(const column_trace_t *trace, const column_chunk_t *chunk, column_t c, word_t *out)
+{
+    const column_span_t *span = &chunk->column[c];
+    const uint8_t *p = trace->base + span->offset;
+    uint32_t n = chunk->rows;
+    switch(span->coding)
+    {
+    case CODING_CONST:
+    {
+        word_t v = get_word(p);
+        for(uint32_t i = 0; i < n; ++i)
+            out[i] = v;
+        break;
+    }
+    case CODING_DELTA8:
+    {
+        word_t v = get_word(p);
+        out[0] = v;
+        for(uint32_t i = 1; i < n; ++i)
+        {
+            v += (word_t)(int8_t)p[i + 1];
+            out[i] = v;
+        }
+        break;
+    }
+    case CODING_DICT8:
+    {
+        //an index past count reads 0.
+        word_t dict[0x100] = {0};
+        uint32_t count = get_word(p);
+        for(uint32_t i = 0; i < count; ++i)
+            dict[i] = get_word(p + 2 + 2 * i);
+        const uint8_t *index = p + 2 + 2 * count;
+        for(uint32_t i = 0; i < n; ++i)
+            out[i] = dict[index[i]];
+        break;
+    }
+    default:
+        //words are stored little endian, like the host.
+        memcpy(out, p, 2ull * n);
+        break;
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include<stdio.h>
+#include<vector>
+
+#include"../type/type.h"
+#include"../engine/isa.h"
+#include"../engine/machine.h"
+
+/*
+columnar instruction trace, one row per retired instruction
+layout, every column chunk aligned to 8 bytes and addressed by file offset:
+    column_header_t
+    column chunks, COLUMN_COUNT per chunk, chunk after chunk
+    column_chunk_t[chunk_count]     the chunk index
+a column chunk holds chunk_rows values of one column, words little endian,
+coded the way that takes the fewest bytes, the index keeps the PC range of
+every chunk so PC filters skip whole chunks without decoding them.
+*/
+
+//"LC3T"
+#define COLUMN_MAGIC 0x5433434C
+#define COLUMN_VERSION 1
+
+//the most rows a chunk holds, writers and readers refuse more.
+#define COLUMN_CHUNK_ROWS 0x10000
+
+enum column_t
+{
+    COLUMN_PC,
+    COLUMN_IR,
+    //data address of a load, store, TRAP or RTI, 0 for the others.
+    COLUMN_ADDR,
+    //the word loaded or stored.
+    COLUMN_VALUE,
+    //cycles since the previous row, interrupt entry included, capped at 0xFFFF.
+    COLUMN_CYCLES,
+    COLUMN_COUNT
+};
+
+enum column_coding_t
+{
+    //one word, every row holds it.
+    CODING_CONST,
+    //the first word, then a signed byte per row, the difference to the row before.
+    CODING_DELTA8,
+    //a word count, up to 256 words, then a byte per row indexing them.
+    CODING_DICT8,
+    //a word per row.
+    CODING_RAW
+};
+
+struct column_header_t
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t isa;
+    uint32_t chunk_rows;
+    uint32_t chunk_count;
+    uint64_t rows;
+    uint64_t index_offset;
+};
+
+struct column_span_t
+{
+    uint64_t offset;
+    uint32_t bytes;
+    uint32_t coding;
+};
+
+struct column_chunk_t
+{
+    uint64_t first_row;
+    uint32_t rows;
+    word_t pc_min;
+    word_t pc_max;
+    //sum of the cycles column.
+    uint64_t cycles;
+    column_span_t column[COLUMN_COUNT];
+};
+
+struct column_writer_t
+{
+    FILE *out;
+    isa_variant_t isa;
+    uint64_t offset;
+    uint64_t rows;
+    bool failed;
+    std::vector<column_chunk_t> index;
+
+    //rows of the open chunk.
+    uint32_t chunk_rows;
+    std::vector<word_t> column[COLUMN_COUNT];
+    std::vector<uint8_t> bytes;
+
+    //registers and cycles after the previous row, the base of a load that
+    //overwrites its base register comes from here.
+    reg_t reg[0x8];
+    uint64_t cycles;
+};
+
+//create path, return false if it cannot be written or chunk_rows is over COLUMN_CHUNK_ROWS.
+//chunk_rows 0 means COLUMN_CHUNK_ROWS.
+bool column_writer_open(column_writer_t *w, const char *path, isa_variant_t isa, uint32_t chunk_rows);
+
+/*
+function define:
+    trace every instruction m retires from now on into w,
+    m->trace is taken over
+*/
+void column_writer_attach(column_writer_t *w, machine_t *m);
+
+void column_writer_append(column_writer_t *w, word_t pc, word_t ir, word_t addr, word_t value, uint16_t cycles);
+
+//flush the open chunk, write the index, return false on a write error.
+bool column_writer_close(column_writer_t *w);
+
+//typed view of a trace file in memory.
+struct column_trace_t
+{
+    const uint8_t *base;
+    uint64_t size;
+
+    const column_header_t *header;
+    const column_chunk_t *chunks;
+};
+
+//map the file read only, return false if it is not a valid trace.
+bool column_trace_open(column_trace_t *trace, const char *path);
+
+void column_trace_close(column_trace_t *trace);
+
+//decode column c of a chunk into out, chunk->rows words.
+void column_decode(const column_trace_t *trace, const column_chunk_t *chunk, column_t c, word_t *out);
+
+#endif //COLUMN_H
@@ -0,0 +1,197 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+
+#include"column.h"
+#include"query.h"
+#include"../test/check.h"
+
+static const char *path = "column_test.trace";
+
+#define ROWS 10
+#define CHUNK_ROWS 4
+
+//run the program in mem from x3000 with every retired instruction recorded to path.
+static bool record(const char *trace_path, isa_variant_t isa, std::vector<word_t> *mem)
+{
+    machine_t *m = new machine_t();
+    machine_init(m, isa, mem->data());
+    m->pc = 0x3000;
+    column_writer_t *w = new column_writer_t();
+    bool ok = column_writer_open(w, trace_path, isa, CHUNK_ROWS);
+    if(ok)
+    {
+        column_writer_attach(w, m);
+        machine_run(m, 100);
+        ok = column_writer_close(w) && m->state == MACHINE_HALTED;
+    }
+    delete w;
+    delete m;
+    return ok;
+}
+
+//every row of column c, in order.
+static std::vector<word_t> column_all(const column_trace_t *trace, column_t c)
+{
+    std::vector<word_t> all;
+    word_t out[CHUNK_ROWS];
+    for(uint32_t i = 0; i < trace->header->chunk_count; ++i)
+    {
+        column_decode(trace, &trace->chunks[i], c, out);
+        all.insert(all.end(), out, out + trace->chunks[i].rows);
+    }
+    return all;
+}
+
+int main()
+{
+    //ADD in a loop at x3000, then LD and ST away from it, the PC column is neither const nor a run.
+    word_t pc[ROWS];
+    word_t ir[ROWS];
+    word_t addr[ROWS];
+    for(int i = 0; i < ROWS; ++i)
+    {
+        bool memory = i >= 6;
+        pc[i] = memory ? (word_t)(0x4000 + i) : (word_t)(0x3000 + i % 3);
+        ir[i] = memory ? (i % 2 ? 0x3201 : 0x2201) : 0x1261;
+        addr[i] = memory ? (word_t)(0x5000 + i * 0x100) : 0;
+    }
+
+    column_writer_t *w = new column_writer_t();
+    CHECK(!column_writer_open(w, path, ISA_LC3, COLUMN_CHUNK_ROWS + 1));
+    CHECK(column_writer_open(w, path, ISA_LC3, CHUNK_ROWS));
+    for(int i = 0; i < ROWS; ++i)
+        column_writer_append(w, pc[i], ir[i], addr[i], (word_t)i, (uint16_t)(i + 1));
+    CHECK(column_writer_close(w));
+    delete w;
+
+    column_trace_t trace;
+    CHECK(column_trace_open(&trace, path));
+    if(trace.base)
+    {
+        CHECK(trace.header->rows == ROWS && trace.header->chunk_count == 3);
+        word_t out[CHUNK_ROWS];
+        int row = 0;
+        for(uint32_t i = 0; i < trace.header->chunk_count; ++i)
+        {
+            const column_chunk_t *chunk = &trace.chunks[i];
+            CHECK(chunk->first_row == (uint64_t)row);
+            column_decode(&trace, chunk, COLUMN_PC, out);
+            CHECK(!memcmp(out, pc + row, chunk->rows * sizeof(word_t)));
+            column_decode(&trace, chunk, COLUMN_IR, out);
+            CHECK(!memcmp(out, ir + row, chunk->rows * sizeof(word_t)));
+            column_decode(&trace, chunk, COLUMN_CYCLES, out);
+            for(uint32_t r = 0; r < chunk->rows; ++r)
+                CHECK(out[r] == row + r + 1);
+            row += chunk->rows;
+        }
+        CHECK(row == ROWS);
+
+        query_mix_t mix;
+        query_mix(&trace, 0, 0xFFFF, &mix);
+        CHECK(mix.rows == ROWS && mix.cycles == ROWS * (ROWS + 1) / 2);
+        CHECK(mix.opcode[0x1] == 6 && mix.opcode[0x2] == 2 && mix.opcode[0x3] == 2);
+        //the range keeps the loads and stores only.
+        query_mix(&trace, 0x4000, 0x4FFF, &mix);
+        CHECK(mix.rows == 4 && mix.opcode[0x1] == 0);
+        column_trace_close(&trace);
+    }
+
+    //a header claiming bigger chunks than any writer makes is refused.
+    FILE *f = fopen(path, "r+b");
+    CHECK(f);
+    if(f)
+    {
+        column_header_t header;
+        CHECK(fread(&header, sizeof(header), 1, f) == 1);
+        header.chunk_rows = COLUMN_CHUNK_ROWS + 1;
+        fseek(f, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, f);
+        fclose(f);
+        CHECK(!column_trace_open(&trace, path));
+    }
+    remove(path);
+
+    //LC-3: LEA R1; LDR R1,R1,#1 and LDR R1,R1,#2 overwrite their base; LEA R2; STR R1,R2,#0;
+    //LD R3; LDR R4,R2,#1; LD R5; HALT. x3010 is stored, x3011 points at x3012.
+    std::vector<word_t> mem(UINT16_MAX, 0);
+    const word_t lc3_code[] = {0xE20F, 0x6241, 0x6242, 0xE40C, 0x7280, 0x260A, 0x6881, 0x2A08, 0xF025};
+    memcpy(&mem[0x3000], lc3_code, sizeof(lc3_code));
+    mem[0x3011] = 0x3012;
+    mem[0x3014] = 0xBEEF;
+    CHECK(record(path, ISA_LC3, &mem));
+    CHECK(column_trace_open(&trace, path));
+    if(trace.base)
+    {
+        const word_t addr_lc3[] = {0, 0x3011, 0x3014, 0, 0x3010, 0x3010, 0x3011, 0x3010, 0x0025};
+        const word_t value_lc3[] = {0, 0x3012, 0xBEEF, 0, 0xBEEF, 0xBEEF, 0x3012, 0xBEEF, 0};
+        std::vector<word_t> a = column_all(&trace, COLUMN_ADDR);
+        std::vector<word_t> v = column_all(&trace, COLUMN_VALUE);
+        CHECK(trace.header->rows == 9 && trace.header->chunk_count == 3);
+        CHECK(a.size() == 9 && !memcmp(a.data(), addr_lc3, sizeof(addr_lc3)));
+        CHECK(v.size() == 9 && !memcmp(v.data(), value_lc3, sizeof(value_lc3)));
+
+        query_pages_t pages;
+        query_pages(&trace, 0, 0xFFFF, &pages);
+        CHECK(pages.load[0x30] == 5 && pages.store[0x30] == 1 && pages.load[0x00] == 1);
+        query_pages(&trace, 0x3005, 0x3007, &pages);
+        CHECK(pages.load[0x30] == 3 && pages.store[0x30] == 0 && pages.load[0x00] == 0);
+
+        //x3011 x3014 x3010 cold, x3010 again at 0, x3011 past x3014 and x3010 at 2,
+        //x3010 past x3011 at 1, the HALT vector cold.
+        query_reuse_t reuse;
+        query_reuse(&trace, 0, 0xFFFF, &reuse);
+        CHECK(reuse.accesses == 7 && reuse.cold == 4);
+        CHECK(reuse.bucket[0] == 1 && reuse.bucket[1] == 1 && reuse.bucket[2] == 1);
+
+        FILE *out = tmpfile();
+        CHECK(query_rows(&trace, 0x3001, 0x3002, 10, out) == 2);
+        CHECK(query_rows(&trace, 0x3001, 0x3002, 1, out) == 1);
+        char text[256];
+        size_t n = 0;
+        if(out)
+        {
+            rewind(out);
+            n = fread(text, 1, sizeof(text) - 1, out);
+            fclose(out);
+        }
+        text[n] = 0;
+        const char *first = "row,pc,ir,addr,value,cycles\n1,x3001,x6241,x3011,x3012,";
+        CHECK(!strncmp(text, first, strlen(first)));
+        CHECK(strstr(text, "\n2,x3002,x6242,x3014,xBEEF,") != 0);
+        column_trace_close(&trace);
+    }
+    remove(path);
+
+    //LC-3b: LEA R1; LDB R2,R1,#3; STB R2,R1,#5; LDB R1,R1,#4 over its base; HALT.
+    mem.assign(UINT16_MAX, 0);
+    const word_t lc3b_code[] = {0xE207, 0x2443, 0x3445, 0x2244, 0xF025};
+    memcpy(&mem[0x3000 >> 1], lc3b_code, sizeof(lc3b_code));
+    mem[0x3012 >> 1] = 0x7F41;
+    mem[0x3014 >> 1] = 0x0080;
+    CHECK(record(path, ISA_LC3B, &mem));
+    CHECK(mem[0x3014 >> 1] == 0x7F80);
+    CHECK(column_trace_open(&trace, path));
+    if(trace.base)
+    {
+        //byte addresses, LDB sign extends, STB stores the low byte.
+        const word_t addr_lc3b[] = {0, 0x3013, 0x3015, 0x3014, 0x004A};
+        const word_t value_lc3b[] = {0, 0x007F, 0x007F, 0xFF80, 0};
+        std::vector<word_t> a = column_all(&trace, COLUMN_ADDR);
+        std::vector<word_t> v = column_all(&trace, COLUMN_VALUE);
+        CHECK(a.size() == 5 && !memcmp(a.data(), addr_lc3b, sizeof(addr_lc3b)));
+        CHECK(v.size() == 5 && !memcmp(v.data(), value_lc3b, sizeof(value_lc3b)));
+
+        query_pages_t pages;
+        query_pages(&trace, 0, 0xFFFF, &pages);
+        CHECK(pages.load[0x30] == 2 && pages.store[0x30] == 1 && pages.load[0x00] == 1);
+        //x3015 and x3014 share a word, distances count words.
+        query_reuse_t reuse;
+        query_reuse(&trace, 0, 0xFFFF, &reuse);
+        CHECK(reuse.accesses == 4 && reuse.cold == 3 && reuse.bucket[0] == 1);
+        column_trace_close(&trace);
+    }
+    remove(path);
+
+    return check_result();
+}
@@ -0,0 +1,356 @@
+#include<string.h>
+#include<vector>
+
+#include"query.h"
+
+//16 rows of one column, GCC lowers the operators to the widest SIMD the target has.
+//aligned for the AVX2 clones, the baseline target would only align to 16.
+typedef uint16_t vword_t __attribute__((vector_size(32), aligned(32)));
+typedef uint32_t vdword_t __attribute__((vector_size(64), aligned(32)));
+#define VWORDS 16
+//the kernels are built for AVX2 as well, the loader picks the clone the CPU runs.
+#define QUERY_KERNEL __attribute__((target_clones("avx2", "default")))
+
+#define REUSE_SLOTS 0x100000
+#define REUSE_NONE UINT32_MAX
+
+//decoded columns and the row mask of the chunk being scanned.
+struct query_scan_t
+{
+    const column_trace_t *trace;
+    word_t pc_lo;
+    word_t pc_hi;
+    uint32_t vectors;
+    //new[] honours the alignment of vword_t, std::vector drops it.
+    vword_t *column[COLUMN_COUNT];
+    //0xFFFF for a row in range, 0 for the others and the padding.
+    vword_t *mask;
+    //per row output of the query kernels.
+    vword_t *scratch;
+};
+
+static void scan_init(query_scan_t *s, const column_trace_t *trace, word_t pc_lo, word_t pc_hi)
+{
+    uint32_t vectors = (trace->header->chunk_rows + VWORDS - 1) / VWORDS;
+    s->trace = trace;
+    s->pc_lo = pc_lo;
+    s->pc_hi = pc_hi;
+    s->vectors = 0;
+    for(int c = 0; c < COLUMN_COUNT; ++c)
+        s->column[c] = new vword_t[vectors];
+    s->mask = new vword_t[vectors];
+    s->scratch = new vword_t[vectors];
+}
+
+static void scan_destroy(query_scan_t *s)
+{
+    for(int c = 0; c < COLUMN_COUNT; ++c)
+        delete[] s->column[c];
+    delete[] s->mask;
+    delete[] s->scratch;
+}
+
+QUERY_KERNEL
+static void scan_mask(const vword_t *pc, uint32_t vectors, word_t pc_lo, word_t pc_hi, vword_t *mask)
+{
+    vword_t lo = vword_t{} + pc_lo;
+    vword_t hi = vword_t{} + pc_hi;
+    for(uint32_t v = 0; v < vectors; ++v)
+        mask[v] = (vword_t)(pc[v] >= lo) & (vword_t)(pc[v] <= hi);
+}
+
+/*
+function define:
+    skip a chunk whose PC range misses [pc_lo, pc_hi], otherwise decode
+    COLUMN_PC and the columns flagged in need, and mark the rows in range
+*/
+static bool scan_chunk(query_scan_t *s, const column_chunk_t *chunk, uint32_t need)
+{
+    if(chunk->pc_max < s->pc_lo || chunk->pc_min > s->pc_hi)
+        return false;
+
+    uint32_t n = chunk->rows;
+    s->vectors = (n + VWORDS - 1) / VWORDS;
+    need |= 1 << COLUMN_PC;
+    for(int c = 0; c < COLUMN_COUNT; ++c)
+    {
+        if(!(need & (1 << c)))
+            continue;
+        word_t *words = (word_t *)s->column[c];
+        column_decode(s->trace, chunk, (column_t)c, words);
+        memset(words + n, 0, (s->vectors * VWORDS - n) * sizeof(word_t));
+    }
+
+    scan_mask(s->column[COLUMN_PC], s->vectors, s->pc_lo, s->pc_hi, s->mask);
+    word_t *mask = (word_t *)s->mask;
+    memset(mask + n, 0, (s->vectors * VWORDS - n) * sizeof(word_t));
+    return true;
+}
+
+//opcodes that read or write data memory, one bit per IR[15:12].
+static void access_masks(const column_trace_t *trace, word_t *load, word_t *store)
+{
+    const op_t *map = trace->header->isa == ISA_LC3B ? lc3b_isa_t::opcode_map : lc3_isa_t::opcode_map;
+    *load = 0;
+    *store = 0;
+    for(int i = 0; i < 16; ++i)
+    {
+        switch(map[i])
+        {
+        case OP_LD:
+        case OP_LDI:
+        case OP_LDR:
+        case OP_LDB:
+        case OP_LDW:
+        case OP_TRAP:
+        case OP_RTI:
+            *load |= (word_t)(1 << i);
+            break;
+        case OP_ST:
+        case OP_STI:
+        case OP_STR:
+        case OP_STB:
+        case OP_STW:
+            *store |= (word_t)(1 << i);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+QUERY_KERNEL
+static void mix_kernel(const vword_t *ir, const vword_t *cycles, const vword_t *mask, uint32_t vectors, query_mix_t *mix)
+{
+    //a lane counts at most chunk_rows / VWORDS rows, 16 bits are enough per chunk.
+    vword_t count[16];
+    for(int k = 0; k < 16; ++k)
+        count[k] = vword_t{};
+    vdword_t cycle_sum = vdword_t{};
+    for(uint32_t v = 0; v < vectors; ++v)
+    {
+        vword_t m = mask[v];
+        vword_t op = ir[v] >> 12;
+        for(int k = 0; k < 16; ++k)
+            count[k] -= (vword_t)(op == (vword_t{} + (word_t)k)) & m;
+        cycle_sum += __builtin_convertvector(cycles[v] & m, vdword_t);
+    }
+    for(int k = 0; k < 16; ++k)
+    {
+        for(int lane = 0; lane < VWORDS; ++lane)
+            mix->opcode[k] += count[k][lane];
+    }
+    for(int lane = 0; lane < VWORDS; ++lane)
+        mix->cycles += cycle_sum[lane];
+}
+
+void query_mix(const column_trace_t *trace, word_t pc_lo, word_t pc_hi, query_mix_t *mix)
+{
+    memset(mix, 0, sizeof(*mix));
+    query_scan_t s;
+    scan_init(&s, trace, pc_lo, pc_hi);
+
+    for(uint32_t i = 0; i < trace->header->chunk_count; ++i)
+    {
+        if(!scan_chunk(&s, &trace->chunks[i], (1 << COLUMN_IR) | (1 << COLUMN_CYCLES)))
+            continue;
+        mix_kernel(s.column[COLUMN_IR], s.column[COLUMN_CYCLES], s.mask, s.vectors, mix);
+    }
+    for(int k = 0; k < 16; ++k)
+        mix->rows += mix->opcode[k];
+    scan_destroy(&s);
+}
+
+//the histogram bin of every row, see query_pages.
+QUERY_KERNEL
+static void pages_kernel(const vword_t *ir, const vword_t *addr, const vword_t *mask, uint32_t vectors,
+                         word_t load, word_t store, vword_t *code)
+{
+    vword_t load_bits = vword_t{} + load;
+    vword_t store_bits = vword_t{} + store;
+    vword_t one = vword_t{} + 1;
+    for(uint32_t v = 0; v < vectors; ++v)
+    {
+        vword_t op = ir[v] >> 12;
+        vword_t is_store = (store_bits >> op) & one;
+        vword_t any = (((load_bits >> op) | (store_bits >> op)) & one) & mask[v];
+        //any is 0 or 1, 0 - any spreads it over the lane.
+        vword_t keep = vword_t{} - any;
+        code[v] = (((addr[v] >> 8) | (is_store << 8)) & keep) | ((vword_t{} + 0x200) & ~keep);
+    }
+}
+
+void query_pages(const column_trace_t *trace, word_t pc_lo, word_t pc_hi, query_pages_t *pages)
+{
+    word_t load;
+    word_t store;
+    access_masks(trace, &load, &store);
+
+    //0x000-0x0FF loads, 0x100-0x1FF stores, 0x200 rows without a selected access.
+    std::vector<uint64_t> hist(0x201, 0);
+    query_scan_t s;
+    scan_init(&s, trace, pc_lo, pc_hi);
+
+    for(uint32_t i = 0; i < trace->header->chunk_count; ++i)
+    {
+        if(!scan_chunk(&s, &trace->chunks[i], (1 << COLUMN_IR) | (1 << COLUMN_ADDR)))
+            continue;
+        pages_kernel(s.column[COLUMN_IR], s.column[COLUMN_ADDR], s.mask, s.vectors,
+                     load, store, s.scratch);
+        const word_t *codes = (const word_t *)s.scratch;
+        for(uint32_t r = 0; r < s.vectors * VWORDS; ++r)
+            ++hist[codes[r]];
+    }
+    for(int p = 0; p < 0x100; ++p)
+    {
+        pages->load[p] = hist[p];
+        pages->store[p] = hist[0x100 + p];
+    }
+    scan_destroy(&s);
+}
+
+//keep is non zero for a row in range whose opcode is in access.
+QUERY_KERNEL
+static void select_kernel(const vword_t *ir, const vword_t *mask, uint32_t vectors, word_t access, vword_t *keep)
+{
+    vword_t access_bits = vword_t{} + access;
+    vword_t one = vword_t{} + 1;
+    for(uint32_t v = 0; v < vectors; ++v)
+        keep[v] = ((access_bits >> (ir[v] >> 12)) & one) & mask[v];
+}
+
+//LRU stack over slots in access order, a live slot marks the last access of an address.
+struct reuse_stack_t
+{
+    std::vector<uint32_t> last;
+    std::vector<uint32_t> owner;
+    //fenwick tree over the slots.
+    std::vector<int32_t> tree;
+    uint32_t next;
+    uint32_t live;
+};
+
+static void reuse_add(reuse_stack_t *r, uint32_t slot, int32_t delta)
+{
+    for(uint32_t i = slot + 1; i <= REUSE_SLOTS; i += i & (0 - i))
+        r->tree[i] += delta;
+}
+
+//live slots up to and including slot.
+static uint32_t reuse_prefix(const reuse_stack_t *r, uint32_t slot)
+{
+    int32_t sum = 0;
+    for(uint32_t i = slot + 1; i; i -= i & (0 - i))
+        sum += r->tree[i];
+    return (uint32_t)sum;
+}
+
+//out of slots, renumber the live ones from 0 in the same order.
+static void reuse_compact(reuse_stack_t *r)
+{
+    uint32_t k = 0;
+    for(uint32_t slot = 0; slot < r->next; ++slot)
+    {
+        uint32_t a = r->owner[slot];
+        if(r->last[a] != slot)
+            continue;
+        r->last[a] = k;
+        r->owner[k++] = a;
+    }
+    r->next = k;
+    memset(r->tree.data(), 0, r->tree.size() * sizeof(int32_t));
+    for(uint32_t slot = 0; slot < k; ++slot)
+        reuse_add(r, slot, 1);
+}
+
+static void reuse_access(reuse_stack_t *r, query_reuse_t *reuse, uint32_t a)
+{
+    if(r->next == REUSE_SLOTS)
+        reuse_compact(r);
+    ++reuse->accesses;
+    uint32_t prev = r->last[a];
+    if(prev == REUSE_NONE)
+    {
+        ++reuse->cold;
+        ++r->live;
+    }
+    else
+    {
+        //distinct addresses touched since the previous access.
+        uint32_t distance = r->live - reuse_prefix(r, prev);
+        uint32_t b = distance ? 32 - __builtin_clz(distance) : 0;
+        ++reuse->bucket[b < REUSE_BUCKETS ? b : REUSE_BUCKETS - 1];
+        reuse_add(r, prev, -1);
+    }
+    r->last[a] = r->next;
+    r->owner[r->next] = a;
+    reuse_add(r, r->next, 1);
+    ++r->next;
+}
+
+void query_reuse(const column_trace_t *trace, word_t pc_lo, word_t pc_hi, query_reuse_t *reuse)
+{
+    memset(reuse, 0, sizeof(*reuse));
+    word_t load;
+    word_t store;
+    access_masks(trace, &load, &store);
+    //distances count words, byte addresses of the LC-3b are folded.
+    int shift = trace->header->isa == ISA_LC3B ? 1 : 0;
+
+    reuse_stack_t r;
+    r.last.assign(0x10000, REUSE_NONE);
+    r.owner.assign(REUSE_SLOTS, 0);
+    r.tree.assign(REUSE_SLOTS + 1, 0);
+    r.next = 0;
+    r.live = 0;
+
+    query_scan_t s;
+    scan_init(&s, trace, pc_lo, pc_hi);
+    for(uint32_t i = 0; i < trace->header->chunk_count; ++i)
+    {
+        if(!scan_chunk(&s, &trace->chunks[i], (1 << COLUMN_IR) | (1 << COLUMN_ADDR)))
+            continue;
+        select_kernel(s.column[COLUMN_IR], s.mask, s.vectors, (word_t)(load | store), s.scratch);
+
+        //the stack walk itself is serial, only the selection is vectorised.
+        const word_t *flags = (const word_t *)s.scratch;
+        const word_t *addr = (const word_t *)s.column[COLUMN_ADDR];
+        for(uint32_t row = 0; row < trace->chunks[i].rows; ++row)
+        {
+            if(flags[row])
+                reuse_access(&r, reuse, addr[row] >> shift);
+        }
+    }
+    scan_destroy(&s);
+}
+
+uint64_t query_rows(const column_trace_t *trace, word_t pc_lo, word_t pc_hi, uint64_t limit, FILE *out)
+{
+    uint64_t printed = 0;
+    query_scan_t s;
+    scan_init(&s, trace, pc_lo, pc_hi);
+    uint32_t need = (1 << COLUMN_IR) | (1 << COLUMN_ADDR) | (1 << COLUMN_VALUE) | (1 << COLUMN_CYCLES);
+
+    fprintf(out, "row,pc,ir,addr,value,cycles\n");
+    for(uint32_t i = 0; i < trace->header->chunk_count && printed < limit; ++i)
+    {
+        const column_chunk_t *chunk = &trace->chunks[i];
+        if(!scan_chunk(&s, chunk, need))
+            continue;
+        const word_t *mask = (const word_t *)s.mask;
+        const word_t *column[COLUMN_COUNT];
+        for(int c = 0; c < COLUMN_COUNT; ++c)
+            column[c] = (const word_t *)s.column[c];
+        for(uint32_t row = 0; row < chunk->rows && printed < limit; ++row)
+        {
+            if(!mask[row])
+                continue;
+            fprintf(out, "%llu,x%04X,x%04X,x%04X,x%04X,%u\n", (unsigned long long)(chunk->first_row + row),
+                    column[COLUMN_PC][row], column[COLUMN_IR][row], column[COLUMN_ADDR][row],
+                    column[COLUMN_VALUE][row], column[COLUMN_CYCLES][row]);
+            ++printed;
+        }
+    }
+    scan_destroy(&s);
+    return printed;
+}
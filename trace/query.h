@@ -0,0 +1,51 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include<stdio.h>
+
+#include"../type/type.h"
+#include"column.h"
+
+//log2 buckets of reuse distances, bucket b counts distances under 2^b.
+#define REUSE_BUCKETS 18
+
+/*
+queries over a columnar trace, every one takes the rows whose PC lies in
+[pc_lo, pc_hi], chunks outside the range are skipped through the index and
+the others are scanned 16 rows at a time with GCC vector extensions
+*/
+
+struct query_mix_t
+{
+    uint64_t rows;
+    uint64_t cycles;
+    //rows per IR[15:12].
+    uint64_t opcode[16];
+};
+
+//data accesses per 256 address page.
+struct query_pages_t
+{
+    uint64_t load[0x100];
+    uint64_t store[0x100];
+};
+
+//LRU stack distance of every data access, counted in distinct addresses.
+struct query_reuse_t
+{
+    uint64_t accesses;
+    //first touch of an address.
+    uint64_t cold;
+    uint64_t bucket[REUSE_BUCKETS];
+};
+
+void query_mix(const column_trace_t *trace, word_t pc_lo, word_t pc_hi, query_mix_t *mix);
+
+void query_pages(const column_trace_t *trace, word_t pc_lo, word_t pc_hi, query_pages_t *pages);
+
+void query_reuse(const column_trace_t *trace, word_t pc_lo, word_t pc_hi, query_reuse_t *reuse);
+
+//print up to limit rows, return the rows printed.
+uint64_t query_rows(const column_trace_t *trace, word_t pc_lo, word_t pc_hi, uint64_t limit, FILE *out);
+
+#endif //QUERY_H
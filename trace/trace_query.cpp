@@ -0,0 +1,205 @@
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+#include<time.h>
+
+#include"column.h"
+#include"query.h"
+#include"../engine/machine.h"
+
+static const char *usage =
+    "usage:\n"
+    "    trace_query record PROGRAM.obj TRACE [MAX_INSTRUCTIONS] [lc3b]\n"
+    "    trace_query info TRACE\n"
+    "    trace_query mix TRACE [PC_LO PC_HI]\n"
+    "    trace_query pages TRACE [PC_LO PC_HI]\n"
+    "    trace_query reuse TRACE [PC_LO PC_HI]\n"
+    "    trace_query rows TRACE [PC_LO PC_HI] [LIMIT]\n"
+    "PC bounds are hex, the range is inclusive.\n";
+
+static double now_seconds()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static bool parse_hex(const char *s, word_t *value)
+{
+    unsigned int v;
+    if(s[0] == 'x' || s[0] == 'X')
+        ++s;
+    if(sscanf(s, "%x", &v) != 1 || v > 0xFFFF)
+        return false;
+    *value = (word_t)v;
+    return true;
+}
+
+static int record(int argc, char *argv[])
+{
+    unsigned long long max = 1000000000ull;
+    if(argc > 4 && sscanf(argv[4], "%llu", &max) != 1)
+    {
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+    isa_variant_t isa = argc > 5 && !strcmp(argv[5], "lc3b") ? ISA_LC3B : ISA_LC3;
+
+    FILE *in = fopen(argv[2], "rb");
+    if(!in)
+    {
+        fprintf(stderr, "cannot read %s\n", argv[2]);
+        return 1;
+    }
+    std::vector<uint8_t> obj;
+    uint8_t buffer[0x1000];
+    for(size_t n; (n = fread(buffer, 1, sizeof(buffer), in)) > 0;)
+        obj.insert(obj.end(), buffer, buffer + n);
+    fclose(in);
+
+    std::vector<word_t> image(UINT16_MAX, 0);
+    machine_t *m = new machine_t();
+    machine_init(m, isa, image.data());
+    machine_load_obj(m, obj.data(), (uint32_t)obj.size());
+
+    column_writer_t *w = new column_writer_t();
+    if(!column_writer_open(w, argv[3], isa, COLUMN_CHUNK_ROWS))
+    {
+        fprintf(stderr, "cannot write %s\n", argv[3]);
+        delete w;
+        delete m;
+        return 1;
+    }
+    column_writer_attach(w, m);
+    double begin = now_seconds();
+    machine_run(m, max);
+    bool ok = column_writer_close(w);
+    fprintf(stderr, "%llu instructions, state %d, %.2f s\n",
+            (unsigned long long)m->instructions, m->state, now_seconds() - begin);
+    delete w;
+    delete m;
+    return ok ? 0 : 1;
+}
+
+static void info(const column_trace_t *trace)
+{
+    static const char *names[COLUMN_COUNT] = {"pc", "ir", "addr", "value", "cycles"};
+    static const char *codings[4] = {"const", "delta8", "dict8", "raw"};
+    const column_header_t *h = trace->header;
+    uint64_t bytes[COLUMN_COUNT] = {0};
+    uint64_t chunks[COLUMN_COUNT][4] = {{0}};
+    for(uint32_t i = 0; i < h->chunk_count; ++i)
+    {
+        for(int c = 0; c < COLUMN_COUNT; ++c)
+        {
+            bytes[c] += trace->chunks[i].column[c].bytes;
+            ++chunks[c][trace->chunks[i].column[c].coding];
+        }
+    }
+    printf("%s, %llu rows, %u chunks of %u rows, %llu bytes\n", h->isa == ISA_LC3B ? "lc3b" : "lc3",
+           (unsigned long long)h->rows, h->chunk_count, h->chunk_rows, (unsigned long long)trace->size);
+    for(int c = 0; c < COLUMN_COUNT; ++c)
+    {
+        printf("%-7s %12llu bytes %6.3f bytes/row ", names[c], (unsigned long long)bytes[c],
+               h->rows ? (double)bytes[c] / h->rows : 0.0);
+        for(int k = 0; k < 4; ++k)
+            printf(" %s:%llu", codings[k], (unsigned long long)chunks[c][k]);
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3)
+    {
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+    if(!strcmp(argv[1], "record"))
+        return argc < 4 ? (fprintf(stderr, "%s", usage), 1) : record(argc, argv);
+    //a range is both bounds, only rows takes a limit after it.
+    if(argc == 4 || argc > 6 || (argc == 6 && strcmp(argv[1], "rows")))
+    {
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+
+    column_trace_t trace;
+    if(!column_trace_open(&trace, argv[2]))
+    {
+        fprintf(stderr, "%s is not a columnar trace\n", argv[2]);
+        return 1;
+    }
+
+    word_t pc_lo = 0;
+    word_t pc_hi = 0xFFFF;
+    if(argc > 4 && (!parse_hex(argv[3], &pc_lo) || !parse_hex(argv[4], &pc_hi)))
+    {
+        fprintf(stderr, "%s", usage);
+        column_trace_close(&trace);
+        return 1;
+    }
+
+    double begin = now_seconds();
+    const char *command = argv[1];
+    int status = 0;
+    if(!strcmp(command, "info"))
+    {
+        info(&trace);
+    }
+    else if(!strcmp(command, "mix"))
+    {
+        query_mix_t mix;
+        query_mix(&trace, pc_lo, pc_hi, &mix);
+        printf("%llu rows, %llu cycles, CPI %.3f\n", (unsigned long long)mix.rows,
+               (unsigned long long)mix.cycles, mix.rows ? (double)mix.cycles / mix.rows : 0.0);
+        for(int k = 0; k < 16; ++k)
+        {
+            if(mix.opcode[k])
+                printf("x%X %12llu %7.3f%%\n", k, (unsigned long long)mix.opcode[k], 100.0 * mix.opcode[k] / mix.rows);
+        }
+    }
+    else if(!strcmp(command, "pages"))
+    {
+        query_pages_t pages;
+        query_pages(&trace, pc_lo, pc_hi, &pages);
+        printf("page     loads       stores\n");
+        for(int p = 0; p < 0x100; ++p)
+        {
+            if(pages.load[p] || pages.store[p])
+                printf("x%02X00 %12llu %12llu\n", p, (unsigned long long)pages.load[p], (unsigned long long)pages.store[p]);
+        }
+    }
+    else if(!strcmp(command, "reuse"))
+    {
+        query_reuse_t reuse;
+        query_reuse(&trace, pc_lo, pc_hi, &reuse);
+        printf("%llu accesses, %llu cold\n", (unsigned long long)reuse.accesses, (unsigned long long)reuse.cold);
+        for(int b = 0; b < REUSE_BUCKETS; ++b)
+        {
+            if(reuse.bucket[b])
+                printf("<%-6u %12llu\n", 1u << b, (unsigned long long)reuse.bucket[b]);
+        }
+    }
+    else if(!strcmp(command, "rows"))
+    {
+        unsigned long long limit = 100;
+        if(argc > 5 && sscanf(argv[5], "%llu", &limit) != 1)
+        {
+            fprintf(stderr, "%s", usage);
+            status = 1;
+        }
+        else
+        {
+            query_rows(&trace, pc_lo, pc_hi, limit, stdout);
+        }
+    }
+    else
+    {
+        fprintf(stderr, "%s", usage);
+        status = 1;
+    }
+    fprintf(stderr, "%.3f s\n", now_seconds() - begin);
+    column_trace_close(&trace);
+    return status;
+}
@@ -16,4 +16,8 @@ typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
+//one LC-3 word, memory cells and registers alike.
+typedef uint16_t word_t;
+typedef uint16_t reg_t;
+
 #endif //TYPE_H
\ No newline at end of file